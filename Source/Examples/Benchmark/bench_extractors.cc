@@ -0,0 +1,316 @@
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <algorithm>
+#include <numeric>
+#include <memory>
+#include <random>
+#include <cstdlib>
+#include <cstring>
+#include <opencv2/opencv.hpp>
+
+#include "FeatureExtractorFactory.h"
+#include "ORBextractor.h"
+using namespace ORB_SLAM2;
+
+/*
+ * Compare two feature extractor configurations on the same images:
+ *   - startup: construction time and resident memory added by the extractor
+ *   - latency: per-image extraction time (mean / median / p90)
+ *   - agreement: keypoints of A found in B (same level, within 1 px) and the
+ *                descriptor distance of those pairs
+ *
+ * Each extractor is given as <Name>[:<Node>], where Name is the registered extractor
+ * and Node the settings node holding its configuration (defaults to Name), e.g.
+ *   bench_extractors fr3.yaml list.txt SuperPoint SuperPoint:SuperPointJit
+ *   bench_extractors fr3.yaml list.txt SuperPoint SuperPointDNN
+ *
+ * Runtimes initialised by the first extractor (LibTorch thread pool, allocator)
+ * are already paid for when the second one starts: compare startup and rss on
+ * separate runs with a single extractor, use the pair for latency and agreement.
+ *
+ * With --simd, check that the ORB SIMD kernels are bit-exact with the scalar ones
+ * (ORB_DISABLE_SIMD unset / set): on every image the full extraction, then the
+ * orientation and rBRIEF stages on random keypoints and angles. Exits with 1 on
+ * any difference, e.g.
+ *   bench_extractors --simd fr3.yaml list.txt [Node=ORB] [random keypoints/img=5000]
+ */
+
+static std::vector<std::string> LoadImageList(const std::string &list)
+{
+    std::ifstream ifs(list);
+    std::vector<std::string> v;
+    for (std::string l; std::getline(ifs, l); )
+        if (!l.empty()) v.push_back(l);
+    return v;
+}
+
+// Resident set size in MB (Linux), -1 if unknown
+static double ReadRSS()
+{
+    std::ifstream ifs("/proc/self/status");
+    for (std::string l; std::getline(ifs, l); )
+        if (l.compare(0, 6, "VmRSS:") == 0)
+            return std::stod(l.substr(6)) / 1024.0;
+    return -1.0;
+}
+
+struct Result
+{
+    std::string label;
+    double startupMs = 0.0;
+    double rssMB = 0.0;
+    std::vector<double> vLatencyMs;
+    std::vector<std::vector<cv::KeyPoint>> vKeys;
+    std::vector<cv::Mat> vDesc;
+};
+
+static bool Run(const std::string &spec, cv::FileStorage &fs, const std::vector<cv::Mat> &vIm, int nWarmup, Result &res)
+{
+    const size_t sep = spec.find(':');
+    const std::string name = spec.substr(0, sep);
+    const std::string node = (sep == std::string::npos) ? name : spec.substr(sep + 1);
+    res.label = spec;
+
+    const double rss0 = ReadRSS();
+    auto t0 = std::chrono::steady_clock::now();
+    std::unique_ptr<FeatureExtractor> pExtractor(
+        FeatureExtractorFactory::Instance().Create(name, fs.root()[node], true));
+    if (!pExtractor) { std::cerr << "Extractor '" << name << "' not registered.\n"; return false; }
+
+    // Startup includes the first call: lazy initialisation (JIT profiling, allocator warm-up) shows up here
+    std::vector<cv::KeyPoint> kps;
+    cv::Mat desc;
+    (*pExtractor)(vIm[0], cv::noArray(), kps, desc);
+    res.startupMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+
+    for (int i = 1; i < nWarmup; i++)
+        (*pExtractor)(vIm[i % vIm.size()], cv::noArray(), kps, desc);
+
+    for (const cv::Mat &im : vIm)
+    {
+        auto t1 = std::chrono::steady_clock::now();
+        (*pExtractor)(im, cv::noArray(), kps, desc);
+        res.vLatencyMs.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t1).count());
+        res.vKeys.push_back(kps);
+        res.vDesc.push_back(desc.clone());
+    }
+    res.rssMB = ReadRSS() - rss0;
+    return true;
+}
+
+static double Percentile(std::vector<double> v, double p)
+{
+    if (v.empty()) return 0.0;
+    std::sort(v.begin(), v.end());
+    return v[std::min(v.size() - 1, static_cast<size_t>(p * (v.size() - 1) + 0.5))];
+}
+
+static void Report(const Result &res)
+{
+    const double mean = std::accumulate(res.vLatencyMs.begin(), res.vLatencyMs.end(), 0.0) / std::max<size_t>(1, res.vLatencyMs.size());
+    size_t nKeys = 0;
+    for (const auto &k : res.vKeys) nKeys += k.size();
+
+    std::cout << "[ " << res.label << " ]\n"
+              << "  startup        : " << res.startupMs << " ms\n"
+              << "  rss            : " << res.rssMB << " MB\n"
+              << "  latency mean   : " << mean << " ms\n"
+              << "  latency median : " << Percentile(res.vLatencyMs, 0.5) << " ms\n"
+              << "  latency p90    : " << Percentile(res.vLatencyMs, 0.9) << " ms\n"
+              << "  keypoints/img  : " << static_cast<double>(nKeys) / std::max<size_t>(1, res.vKeys.size()) << "\n";
+}
+
+static void ReportAgreement(const Result &a, const Result &b)
+{
+    size_t nKeys = 0, nPaired = 0;
+    double sumDist = 0.0, sumCos = 0.0;
+    bool bBinary = false;
+
+    for (size_t i = 0; i < a.vKeys.size(); i++)
+    {
+        const auto &ka = a.vKeys[i];
+        const auto &kb = b.vKeys[i];
+        const cv::Mat &da = a.vDesc[i];
+        const cv::Mat &db = b.vDesc[i];
+        if (da.empty() || db.empty() || da.type() != db.type() || da.cols != db.cols)
+            continue;
+        bBinary = da.type() == CV_8U;
+        nKeys += ka.size();
+
+        for (size_t j = 0; j < ka.size(); j++)
+        {
+            int best = -1;
+            float bestD2 = 1.0f;
+            for (size_t k = 0; k < kb.size(); k++)
+            {
+                if (kb[k].octave != ka[j].octave) continue;
+                const float dx = kb[k].pt.x - ka[j].pt.x, dy = kb[k].pt.y - ka[j].pt.y;
+                const float d2 = dx * dx + dy * dy;
+                if (d2 <= bestD2) { bestD2 = d2; best = static_cast<int>(k); }
+            }
+            if (best < 0) continue;
+
+            nPaired++;
+            if (bBinary)
+                sumDist += cv::norm(da.row(j), db.row(best), cv::NORM_HAMMING);
+            else
+            {
+                sumDist += cv::norm(da.row(j), db.row(best), cv::NORM_L2);
+                const double n = cv::norm(da.row(j)) * cv::norm(db.row(best));
+                sumCos += n > 0.0 ? da.row(j).dot(db.row(best)) / n : 0.0;
+            }
+        }
+    }
+
+    std::cout << "[ Agreement " << a.label << " vs " << b.label << " ]\n"
+              << "  paired keypoints : " << nPaired << " / " << nKeys
+              << " (" << 100.0 * nPaired / std::max<size_t>(1, nKeys) << " %)\n"
+              << "  mean " << (bBinary ? "hamming" : "L2") << " dist : " << sumDist / std::max<size_t>(1, nPaired) << "\n";
+    if (!bBinary)
+        std::cout << "  mean cosine sim  : " << sumCos / std::max<size_t>(1, nPaired) << "\n";
+}
+
+// Run fn with the scalar kernels forced (ORB_DISABLE_SIMD set) or with the dispatched ones
+template <class Fn>
+static void WithScalar(bool bScalar, Fn fn)
+{
+    if (bScalar) setenv("ORB_DISABLE_SIMD", "1", 1);
+    else         unsetenv("ORB_DISABLE_SIMD");
+    fn();
+    unsetenv("ORB_DISABLE_SIMD");
+}
+
+static bool SameBits(float a, float b) { return std::memcmp(&a, &b, sizeof(float)) == 0; }
+
+static size_t CountDescriptorDiffs(const cv::Mat &a, const cv::Mat &b)
+{
+    if (a.size() != b.size() || a.type() != b.type()) return std::max(a.rows, b.rows);
+    size_t n = 0;
+    for (int i = 0; i < a.rows; i++)
+        if (std::memcmp(a.ptr(i), b.ptr(i), a.cols * a.elemSize()) != 0) n++;
+    return n;
+}
+
+static int CheckSimd(int argc, char **argv)
+{
+    if (argc < 4) {
+        std::cerr << "Usage: " << argv[0] << " --simd <settings.yaml> <imagelist.txt> [Node=ORB] [random=5000]\n";
+        return 1;
+    }
+
+    cv::FileStorage fs(argv[2], cv::FileStorage::READ);
+    if (!fs.isOpened()) { std::cerr << "Cannot open " << argv[2] << "\n"; return 2; }
+    const std::string node = (argc >= 5) ? argv[4] : "ORB";
+    const int nRandom = (argc >= 6) ? std::stoi(argv[5]) : 5000;
+
+    std::unique_ptr<FeatureExtractor> pBase(FeatureExtractorFactory::Instance().Create("ORB", fs.root()[node], true));
+    ORBextractor *pExtractor = dynamic_cast<ORBextractor *>(pBase.get());
+    if (!pExtractor) { std::cerr << "Extractor 'ORB' not registered.\n"; return 3; }
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    if (!__builtin_cpu_supports("avx2"))
+        std::cout << "AVX2 not supported: both runs use the scalar kernels\n";
+#endif
+
+    std::mt19937 rng(0);
+    size_t nImages = 0, nKeys = 0, nPoints = 0;
+    size_t nKeyDiffs = 0, nDescDiffs = 0, nAngleDiffs = 0, nRandomDescDiffs = 0;
+
+    for (auto &path : LoadImageList(argv[3]))
+    {
+        const cv::Mat im = cv::imread(path, cv::IMREAD_GRAYSCALE);
+        if (im.empty()) { std::cerr << "Skip " << path << "\n"; continue; }
+        nImages++;
+
+        // Full extraction: keypoints, angles and descriptors
+        std::vector<cv::KeyPoint> vSimdKeys, vScalarKeys;
+        cv::Mat simdDesc, scalarDesc;
+        WithScalar(false, [&] { (*pExtractor)(im, cv::noArray(), vSimdKeys, simdDesc); });
+        WithScalar(true,  [&] { (*pExtractor)(im, cv::noArray(), vScalarKeys, scalarDesc); });
+
+        nKeys += vScalarKeys.size();
+        if (vSimdKeys.size() != vScalarKeys.size())
+            nKeyDiffs += std::max(vSimdKeys.size(), vScalarKeys.size());
+        else
+            for (size_t i = 0; i < vScalarKeys.size(); i++)
+                if (vSimdKeys[i].pt != vScalarKeys[i].pt || vSimdKeys[i].octave != vScalarKeys[i].octave ||
+                    !SameBits(vSimdKeys[i].angle, vScalarKeys[i].angle))
+                    nKeyDiffs++;
+        nDescDiffs += CountDescriptorDiffs(simdDesc, scalarDesc);
+
+        // Random sub-pixel keypoints away from the border (the patches and the rotated
+        // pattern stay inside the image), random angles for the descriptors
+        const float margin = FeatureExtractor::EDGE_THRESHOLD;
+        if (im.cols <= 2 * margin || im.rows <= 2 * margin) continue;
+        std::uniform_real_distribution<float> ux(margin, im.cols - margin - 1), uy(margin, im.rows - margin - 1), ua(0.0f, 360.0f);
+        std::vector<cv::KeyPoint> vRandom(nRandom);
+        for (cv::KeyPoint &kp : vRandom) { kp.pt = cv::Point2f(ux(rng), uy(rng)); kp.octave = 0; }
+        nPoints += vRandom.size();
+
+        std::vector<cv::KeyPoint> vSimd = vRandom, vScalar = vRandom;
+        WithScalar(false, [&] { pExtractor->ComputeOrientation(im, vSimd); });
+        WithScalar(true,  [&] { pExtractor->ComputeOrientation(im, vScalar); });
+        for (size_t i = 0; i < vRandom.size(); i++)
+            if (!SameBits(vSimd[i].angle, vScalar[i].angle)) nAngleDiffs++;
+
+        cv::Mat blurred;
+        cv::GaussianBlur(im, blurred, cv::Size(7, 7), 2, 2, cv::BORDER_REFLECT_101);
+        for (cv::KeyPoint &kp : vRandom) kp.angle = ua(rng);
+        vSimd = vRandom;
+        vScalar = vRandom;
+        WithScalar(false, [&] { pExtractor->ComputeDescriptors(blurred, vSimd, simdDesc); });
+        WithScalar(true,  [&] { pExtractor->ComputeDescriptors(blurred, vScalar, scalarDesc); });
+        nRandomDescDiffs += CountDescriptorDiffs(simdDesc, scalarDesc);
+    }
+    if (nImages == 0) { std::cerr << "No images loaded.\n"; return 2; }
+
+    std::cout << "[ ORB SIMD vs scalar, " << nImages << " images ]\n"
+              << "  extraction keypoints differing  : " << nKeyDiffs << " / " << nKeys << "\n"
+              << "  extraction descriptors differing: " << nDescDiffs << " / " << nKeys << "\n"
+              << "  random angles differing         : " << nAngleDiffs << " / " << nPoints << "\n"
+              << "  random descriptors differing    : " << nRandomDescDiffs << " / " << nPoints << "\n";
+
+    const bool bExact = nKeyDiffs == 0 && nDescDiffs == 0 && nAngleDiffs == 0 && nRandomDescDiffs == 0;
+    std::cout << (bExact ? "  bit-exact\n" : "  MISMATCH\n");
+    return bExact ? 0 : 1;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc >= 2 && std::string(argv[1]) == "--simd")
+        return CheckSimd(argc, argv);
+
+    if (argc < 4) {
+        std::cerr << "Usage: " << argv[0]
+                  << " <settings.yaml> <imagelist.txt> <Name[:Node]> [Name[:Node]] [warmup=5]\n";
+        return 1;
+    }
+
+    cv::FileStorage fs(argv[1], cv::FileStorage::READ);
+    if (!fs.isOpened()) { std::cerr << "Cannot open " << argv[1] << "\n"; return 2; }
+
+    std::vector<cv::Mat> vIm;
+    for (auto &path : LoadImageList(argv[2]))
+    {
+        cv::Mat im = cv::imread(path, cv::IMREAD_GRAYSCALE);
+        if (im.empty()) { std::cerr << "Skip " << path << "\n"; continue; }
+        vIm.push_back(im);
+    }
+    if (vIm.empty()) { std::cerr << "No images loaded.\n"; return 2; }
+    std::cout << "Total images: " << vIm.size() << "\n";
+
+    const int nWarmup = (argc >= 6) ? std::stoi(argv[5]) : 5;
+
+    Result a, b;
+    if (!Run(argv[3], fs, vIm, nWarmup, a)) return 3;
+    Report(a);
+
+    if (argc >= 5)
+    {
+        if (!Run(argv[4], fs, vIm, nWarmup, b)) return 3;
+        Report(b);
+        ReportAgreement(a, b);
+    }
+    return 0;
+}
@@ -7,6 +7,7 @@
 
 #include "Frame.h"
 #include "KeyFrame.h"
+#include "LocalMapDescriptors.h"
 #include "MapPoint.h"
 
 namespace ORB_SLAM2 {
@@ -18,14 +19,16 @@ public:
   // Computes the Hamming distance between two ORB descriptors
   // static int DescriptorDistance(const cv::Mat &a, const cv::Mat &b);
 
-  // Computes the Hamming / Euclidean distance between two descriptors
+  // Computes the Hamming / Euclidean distance between two descriptors (inside loops, use a DescriptorMetric)
   static float DescriptorDistance(const cv::Mat &a, const cv::Mat &b);
 
   // Project MapPoints tracked in last frame into the current frame and search matches. Used to track from previous frame (Tracking)
   int SearchByProjection(Frame &CurrentFrame, const Frame &LastFrame, const float th, const bool bMono, const int Ftype);
 
   // Search matches between Frame keypoints and projected MapPoints. Returns number of matches Used to track the local map (Tracking)
-  int SearchByProjection(Frame &F, const std::vector<MapPoint*> &vpMapPoints, const float th);
+  // The descriptors of the points are read from pLocalDescriptors when given (and holding them)
+  int SearchByProjection(Frame &F, const std::vector<MapPoint*> &vpMapPoints, const float th,
+                         const LocalMapDescriptors *pLocalDescriptors = NULL);
 
   // Project MapPoints using a Similarity Transformation and search matches. Used in loop detection (Loop Closing)
   int SearchByProjection(KeyFrame *pKF, cv::Mat Scw, const std::vector<MapPoint *> &vpPoints, std::vector<MapPoint *> &vpMatched, int th, const int Ftype);
@@ -37,6 +40,11 @@ public:
 
   int SearchByBoW(KeyFrame *pKF1, KeyFrame *pKF2, std::vector<MapPoint *> &vpMatches12, const int Ftype);
 
+  // Same rules as SearchByBoW(pKF, F), the candidates of each Frame keypoint are its approximate nearest
+  // neighbours in the KeyFrame's cached descriptor index. Used in relocalisation when the BoW matching
+  // finds too few matches (Tracking)
+  int SearchByIndex(KeyFrame *pKF, Frame &F, std::vector<MapPoint *> &vpMapPointMatches, const int Ftype);
+
   int SearchByNN(Frame &CurrentFrame, const Frame &LastFrame, const int Ftype);
   
   int SearchByNN(KeyFrame *pKF, Frame &F, std::vector<MapPoint *> &vpMapPointMatches, const int Ftype);
@@ -63,6 +71,11 @@ public:
   static std::vector<float> mvTH_LOW;
   static std::vector<float> mvTH_HIGH;
   static const int HISTO_LENGTH;
+  static const int INDEX_KNN;
+  // SearchByNN: search radius around a predicted position at octave 0, and largest row x
+  // keypoint count matched exhaustively (approximate indices above it)
+  static const float NN_RADIUS;
+  static const size_t NN_EXHAUSTIVE_PAIRS;
 
 protected:
   float mfNNratio;
@@ -72,6 +85,17 @@ protected:
 
   float RadiusByViewingCos(const float &viewCos);
 
+  // Mutual nearest neighbours between the rows of Q and the keypoints of channel Ftype of F (same
+  // descriptor layout). Only the rows vQueryRows are searched, but every row of Q takes part in the
+  // mutual check: a keypoint with a nearer row than the one that found it is not matched.
+  // With a prior (one position and radius per searched row) the candidates are the keypoints of the
+  // grid window around it, otherwise all keypoints, through approximate indices for large sets.
+  // pQueryIndex optionally indexes Q and replaces the index otherwise built over it.
+  // vMatches[q] is the keypoint matched by row vQueryRows[q], or -1.
+  void SearchMutualNN(const cv::Mat &Q, const std::vector<int> &vQueryRows, const std::vector<cv::Point2f> &vPrior,
+                      const std::vector<float> &vRadius, const Frame &F, const int Ftype, std::vector<int> &vMatches,
+                      std::vector<float> &vDists, const DescriptorIndex *pQueryIndex = NULL);
+
   bool CheckDistEpipolarLine(const cv::KeyPoint &kp1, const cv::KeyPoint &kp2, const cv::Mat &F12, const KeyFrame *pKF);
 
 };
@@ -0,0 +1,81 @@
+#ifndef COPYONWRITE_H
+#define COPYONWRITE_H
+
+#include <memory>
+#include <utility>
+
+namespace ORB_SLAM2 {
+
+/**
+ * @brief Value shared between copies until one of them is modified.
+ *
+ *        Copying is a reference count increment. Reads go through the const
+ *        interface (operator[], begin/end, size, find, ... forwarded to T, or an
+ *        implicit const T&), so reading through a non-const object never copies.
+ *        Writes must go through edit(), which first detaches the value if another
+ *        copy still references it. Assigning a T replaces the value.
+ *
+ *        A default constructed value is empty and allocates nothing.
+ */
+template <class T>
+class CopyOnWrite {
+public:
+  CopyOnWrite() {}
+  CopyOnWrite(const T &value) : mpValue(std::make_shared<T>(value)) {}
+  CopyOnWrite(T &&value) : mpValue(std::make_shared<T>(std::move(value))) {}
+
+  CopyOnWrite &operator=(const T &value) {
+    mpValue = std::make_shared<T>(value);
+    return *this;
+  }
+  CopyOnWrite &operator=(T &&value) {
+    mpValue = std::make_shared<T>(std::move(value));
+    return *this;
+  }
+
+  const T &get() const { return mpValue ? *mpValue : Empty(); }
+  operator const T &() const { return get(); }
+  const T *operator->() const { return &get(); }
+
+  // Writable value, private to this copy
+  T &edit() {
+    if (!mpValue)
+      mpValue = std::make_shared<T>();
+    else if (mpValue.use_count() > 1)
+      mpValue = std::make_shared<T>(*mpValue);
+    return *mpValue;
+  }
+
+  // Drop the reference, the value becomes empty
+  void clear() { mpValue.reset(); }
+
+  // Const container interface of T
+  template <class U = T>
+  auto size() const -> decltype(std::declval<const U &>().size()) { return get().size(); }
+  template <class U = T>
+  auto empty() const -> decltype(std::declval<const U &>().empty()) { return get().empty(); }
+  template <class U = T>
+  auto begin() const -> decltype(std::declval<const U &>().begin()) { return get().begin(); }
+  template <class U = T>
+  auto end() const -> decltype(std::declval<const U &>().end()) { return get().end(); }
+  template <class K, class U = T>
+  auto operator[](const K &key) const -> decltype(std::declval<const U &>()[key]) { return get()[key]; }
+  template <class K, class U = T>
+  auto find(const K &key) const -> decltype(std::declval<const U &>().find(key)) { return get().find(key); }
+  template <class K, class U = T>
+  auto lower_bound(const K &key) const -> decltype(std::declval<const U &>().lower_bound(key)) {
+    return get().lower_bound(key);
+  }
+
+private:
+  static const T &Empty() {
+    static const T empty;
+    return empty;
+  }
+
+  std::shared_ptr<T> mpValue;
+};
+
+} // namespace ORB_SLAM2
+
+#endif // COPYONWRITE_H
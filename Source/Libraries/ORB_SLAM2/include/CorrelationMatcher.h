@@ -6,20 +6,6 @@
 #include "Frame.h"
 
 namespace ORB_SLAM2 {
-    /**
-     * @brief For a given frame F, perform KD-Tree radius search between two feature channels:
-     *        For each successfully matched point in channel chA, search for points in channel chB
-     *        within a pixel distance < th_px. For each match found, call MapPoint::AddEdge() to
-     *        increment edge weight between the corresponding MapPoints.
-     *
-     * @param F       The current frame (can be a Frame or a KeyFrame)
-     * @param chA     Source feature channel index
-     * @param chB     Target feature channel index (can be greater or less than chA)
-     * @param th_px   Pixel radius threshold (default is 2.0f)
-     *
-     * @return The Redundancy Dice Index of the current frame between the two features
-     */
-
     struct CorrFrameStat{
         long unsigned int frameId;
         int chA, chB;
@@ -31,10 +17,52 @@ namespace ORB_SLAM2 {
     public:
         CorrelationMatcher();
         void Finalize();
-        float BuildEdges(Frame& F, int chA, int chB, float th_px = 2.0f, size_t th_str = 3);
+
+        /**
+         * @brief For a given frame F, link the co-located matched points of every channel pair:
+         *        for each pair of successfully matched points of two different channels within a
+         *        pixel distance <= th_px, call MapPoint::AddEdge() to increment the edge weight
+         *        between the corresponding MapPoints. One CorrFrameStat is recorded per channel
+         *        pair holding points in both channels.
+         *
+         *        The points of all channels are bucketed once in a uniform grid of th_px cells
+         *        (counting sort, buffers kept between frames), and each point is only compared
+         *        with the points of the higher channels in its 3x3 neighbouring cells.
+         *
+         * @param F       The current frame
+         * @param th_px   Pixel radius threshold (default is 2.0f)
+         * @param th_str  Edge count from which a pair is counted as correlated in the stats
+         */
+        void BuildEdges(Frame& F, float th_px = 2.0f, size_t th_str = 3);
+
+        /**
+         * @brief Correlation-guided search: for each MapPoint already matched in F, its strong
+         *        partners in the other channels (edge counter >= th_str) are searched only among
+         *        the keypoints within th_px of the matched keypoint, at the scale level predicted
+         *        from the pose of F. A partner is accepted under the same rules as the local map
+         *        search (Associater::SearchByProjection): TH_HIGH, and the nnratio test between
+         *        candidates of the same level. Matched partners are marked as seen in F
+         *        (mnLastFrameSeen), so the wide local map search skips them.
+         *
+         * @return The number of partners matched
+         */
+        int SearchCorrelated(Frame& F, float th_px = 2.0f, size_t th_str = 5, float nnratio = 0.8f);
 
     private:
+        struct GridPoint{
+            float x, y;
+            int ch;
+            MapPoint* pMP;
+        };
+
         std::vector<CorrFrameStat> mvStats;
+
+        // BuildEdges grid: points of all channels, sorted by cell (mvCellStart[c] .. mvCellStart[c+1])
+        std::vector<GridPoint> mvPoints;
+        std::vector<GridPoint> mvSorted;
+        std::vector<int> mvCell;
+        std::vector<int> mvCellStart;
+        std::vector<int> mvNext;
     };
 
 } // namespace
@@ -0,0 +1,46 @@
+#ifndef DESCRIPTORINDEX_H
+#define DESCRIPTORINDEX_H
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/flann.hpp>
+
+namespace ORB_SLAM2 {
+
+/**
+ * @brief Approximate nearest neighbour index over the rows of a descriptor matrix.
+ *
+ *        Binary (CV_8U) descriptors are hashed into multi-probe LSH tables under the
+ *        Hamming distance, float (CV_32F) ones go to a randomized kd-forest. The
+ *        descriptor matrix is shared, not copied, and kept alive by the index.
+ *
+ *        Built once, then only searched: concurrent searches are safe. Keyframes
+ *        cache one per channel (KeyFrame::GetDescriptorIndex), built by LocalMapping
+ *        when it processes the keyframe.
+ */
+class DescriptorIndex {
+public:
+  explicit DescriptorIndex(const cv::Mat &descriptors);
+
+  // k approximate nearest rows of every row of Q (same layout as the indexed descriptors):
+  // indices is Q.rows x k (CV_32S), nearest first, -1 where none is found
+  void Search(const cv::Mat &Q, const int k, cv::Mat &indices) const;
+
+  int Size() const { return mDescriptors.rows; }
+
+public:
+  static const int LSH_TABLES;
+  static const int LSH_KEY_SIZE;
+  static const int LSH_MULTI_PROBE;
+  static const int KD_TREES;
+  static const int CHECKS;
+
+private:
+  cv::Mat mDescriptors;
+
+  // cv::flann::Index::knnSearch is not const but does not modify the index
+  mutable cv::flann::Index mIndex;
+};
+
+} // namespace ORB_SLAM2
+
+#endif // DESCRIPTORINDEX_H
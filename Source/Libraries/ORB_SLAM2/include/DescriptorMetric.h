@@ -0,0 +1,86 @@
+#ifndef DESCRIPTORMETRIC_H
+#define DESCRIPTORMETRIC_H
+
+#include <cstddef>
+
+#include <opencv2/core/core.hpp>
+
+namespace ORB_SLAM2 {
+
+// Nearest and second nearest candidates of a search (index -1: no candidate)
+struct DescriptorMatch {
+  float bestDist;
+  int bestIdx;
+  float secondDist;
+  int secondIdx;
+};
+
+/**
+ * @brief Distance between descriptors of one layout: Hamming for binary (CV_8U)
+ *        descriptors, Euclidean for float (CV_32F) ones.
+ *
+ *        The kernel is chosen when the object is built, from the descriptor depth and
+ *        length and from the instruction sets of the CPU (detected once per process):
+ *          - binary: AVX-512 VPOPCNTDQ with masked loads (any length up to 64 bytes,
+ *            e.g. 61 byte AKAZE), AVX2 nibble popcount (32 / 64 bytes), 64-bit POPCNT,
+ *            or portable 64-bit words;
+ *          - float: AVX2 FMA (lengths multiple of 8, unrolled for 64 / 128 / 256), or
+ *            four independent portable sums.
+ *        Matchers build one object per channel, outside their loops, so the inner
+ *        loops neither branch on the descriptor type nor walk descriptors byte by byte.
+ *        The batch entry points compare one descriptor with many.
+ */
+class DescriptorMetric {
+public:
+  // Metric for descriptors laid out as desc (one descriptor or a descriptor matrix)
+  explicit DescriptorMetric(const cv::Mat &desc);
+  DescriptorMetric(const int depth, const int length);
+
+  float operator()(const uchar *a, const uchar *b) const {
+    float dist;
+    mKernel(a, b, 0, NULL, 1, mnLength, &dist);
+    return dist;
+  }
+
+  float operator()(const cv::Mat &a, const cv::Mat &b) const { return (*this)(a.data, b.data); }
+
+  // Distances from a to every row of D
+  void Batch(const uchar *a, const cv::Mat &D, float *pDist) const {
+    mKernel(a, D.data, D.step[0], NULL, D.rows, mnLength, pDist);
+  }
+
+  // Distances from a to the rows pIdx[0..n) of D
+  void Batch(const uchar *a, const cv::Mat &D, const std::size_t *pIdx, const int n, float *pDist) const {
+    mKernel(a, D.data, D.step[0], pIdx, n, mnLength, pDist);
+  }
+
+  // Distances from a to n descriptors anywhere in memory (e.g. one per map point)
+  void Batch(const uchar *a, const uchar *const *ppB, const int n, float *pDist) const;
+
+  // Nearest and second nearest of the rows pIdx[0..n) of D to a, in one pass over the
+  // candidates. On equal distances the earlier candidate ranks first.
+  DescriptorMatch Match(const uchar *a, const cv::Mat &D, const std::size_t *pIdx, const int n) const;
+
+  int GetDepth() const { return mnDepth; }
+  int GetLength() const { return mnLength; }
+
+  // Kernel in use, e.g. "hamming64/avx2"
+  const char *GetName() const { return mpName; }
+
+  // Distance between two descriptors, choosing the kernel on the fly (prefer a DescriptorMetric in loops)
+  static float Distance(const cv::Mat &a, const cv::Mat &b);
+
+private:
+  // pDist[k] = d(a, B + step * (pIdx ? pIdx[k] : k)) for k < n
+  typedef void (*Kernel)(const uchar *a, const uchar *B, const std::size_t step, const std::size_t *pIdx, const int n,
+                         const int length, float *pDist);
+
+  Kernel mKernel;
+  int mnDepth;
+  int mnLength;
+  const char *mpName;
+};
+
+} // namespace ORB_SLAM2
+
+#endif // DESCRIPTORMETRIC_H
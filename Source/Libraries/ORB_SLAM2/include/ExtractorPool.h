@@ -0,0 +1,78 @@
+#ifndef EXTRACTORPOOL_H
+#define EXTRACTORPOOL_H
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ORB_SLAM2 {
+
+/**
+ * @brief Long-lived worker threads shared by all feature channels.
+ *
+ *        Tasks are queued per channel and workers take them round-robin across
+ *        the channel queues, so one slow channel cannot starve the others. The
+ *        threads are created once (by Tracking) and reused for every frame.
+ *        Queue latency and run time of each task are recorded through Perf as
+ *        "Extract Queue" and "Extract Run".
+ *
+ *        Submit()/Wait() are meant to be driven from a single thread (the
+ *        tracking thread): Wait() blocks until every submitted task finished
+ *        and rethrows the first exception raised by a task.
+ *
+ *        The tracking thread also runs per-channel work other than extraction
+ *        on the pool (local map search). Such tasks are submitted untimed: they
+ *        are neither recorded through Perf nor counted in the run times.
+ */
+class ExtractorPool {
+public:
+  // nThreads <= 0 sizes the pool to the machine (bounded by 2 tasks per channel: left/right).
+  ExtractorPool(const int Ntype, int nThreads = 0);
+  ~ExtractorPool();
+
+  ExtractorPool(const ExtractorPool &) = delete;
+  ExtractorPool &operator=(const ExtractorPool &) = delete;
+
+  void Submit(const int Ftype, std::function<void()> task, const bool bTimed = true);
+  void Wait();
+
+  int GetNumThreads() const { return static_cast<int>(mvWorkers.size()); }
+
+  // Run time (ms) spent on each channel's timed tasks between the last two Wait() calls that had timed tasks
+  const std::vector<double> &GetLastRunTimes() const { return mvLastRunMs; }
+
+private:
+  struct Task {
+    std::function<void()> fn;
+    std::chrono::steady_clock::time_point tEnqueue;
+    std::size_t queue;
+    bool bTimed;
+  };
+
+  void Run();
+  bool PopTask(Task &task);
+
+  std::vector<std::deque<Task>> mvQueues;
+  std::vector<double> mvRunMs;
+  std::vector<double> mvLastRunMs;
+  std::vector<std::thread> mvWorkers;
+
+  std::mutex mMutex;
+  std::condition_variable mCondTask;
+  std::condition_variable mCondDone;
+
+  std::size_t mnPending;
+  std::size_t mnNextQueue;
+  bool mbTimed;
+  bool mbStop;
+  std::exception_ptr mpError;
+};
+
+} // namespace ORB_SLAM2
+
+#endif // EXTRACTORPOOL_H
@@ -0,0 +1,72 @@
+#ifndef FEATUREBUDGET_H
+#define FEATUREBUDGET_H
+
+#include <deque>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+namespace ORB_SLAM2 {
+
+/**
+ * @brief Moves a global keypoint budget between feature channels.
+ *
+ *        Each tracked frame reports, per channel, the keypoints extracted, the
+ *        inliers kept by PoseOptimizationMultiChannels and the extraction time.
+ *        Over a sliding window every channel is scored by its inlier yield per
+ *        keypoint divided by (extraction ms per keypoint)^cost_weight. Every
+ *        'period' frames the budget is split in proportion to the scores,
+ *        clamped to the per-channel [nFeaturesMin, nFeaturesMax], and each
+ *        channel moves a fraction 'smoothing' of the way to its target.
+ *        Channels not extracted on a frame (lazy extraction) add no sample, and
+ *        a channel keeps its budget until its window is full.
+ *
+ *        Settings ("FeatureBudget" node, disabled by default):
+ *          enabled, total (0: sum of the extractors' nFeatures), window, period,
+ *          smoothing, cost_weight, min_ratio / max_ratio (bounds relative to
+ *          nFeatures for extractors without nFeaturesMin / nFeaturesMax).
+ */
+class FeatureBudget {
+public:
+  // vnFeatures: configured nFeatures of each channel, vExtractorConfigs: their settings nodes
+  FeatureBudget(const cv::FileNode &node, const std::vector<int> &vnFeatures,
+                const std::vector<cv::FileNode> &vExtractorConfigs);
+
+  bool IsEnabled() const { return mbEnabled; }
+
+  // Feed one tracked frame. Only the channels flagged in vbSampled (extracted and tracked on
+  // the frame) add a sample. Returns true when the budgets changed.
+  bool AddFrame(const std::vector<int> &vnKeys, const std::vector<int> &vnInliers,
+                const std::vector<double> &vCostMs, const std::vector<bool> &vbSampled);
+
+  const std::vector<int> &GetBudgets() const { return mvnBudget; }
+
+  void InfoConfigs() const;
+
+private:
+  struct Sample {
+    int nKeys;
+    int nInliers;
+    double costMs;
+  };
+
+  void Reallocate();
+
+  bool mbEnabled;
+  int mnTotal;
+  int mnWindow;
+  int mnPeriod;
+  float mSmoothing;
+  float mCostWeight;
+
+  std::vector<int> mvnMin;
+  std::vector<int> mvnMax;
+  std::vector<int> mvnBudget;
+
+  std::vector<std::deque<Sample>> mvWindow;
+  int mnFramesSinceUpdate;
+};
+
+} // namespace ORB_SLAM2
+
+#endif // FEATUREBUDGET_H
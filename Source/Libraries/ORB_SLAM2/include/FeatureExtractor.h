@@ -6,6 +6,8 @@
 #include <opencv2/opencv.hpp>
 #include <vector>
 
+#include "ImagePyramidCache.h"
+
 namespace ORB_SLAM2 {
 class FeatureExtractor {
 public:
@@ -33,6 +35,11 @@ public:
 
   int GetLevels() const { return nlevels; }
 
+  int GetNumFeatures() const { return nfeatures; }
+
+  // Change the keypoint budget between frames (redistributes it over the levels).
+  virtual void SetNumFeatures(int n);
+
   float GetScaleFactor() const { return scaleFactor; }
 
   std::vector<float> GetScaleFactors() const { return mvScaleFactor; }
@@ -45,6 +52,9 @@ public:
     return mvInvLevelSigma2;
   }
 
+  // Share pyramids with the other channels working on the same image (NULL: build privately).
+  void SetPyramidCache(ImagePyramidCache *pCache) { mpPyramidCache = pCache; }
+
   std::vector<cv::Mat> mvImagePyramid;
 
 protected:
@@ -56,8 +66,13 @@ protected:
 
   void InitPyramidParameters();
 
+  void ComputeFeaturesPerLevel();
+
   void ComputePyramid(cv::Mat image);
 
+  ImagePyramidCache *mpPyramidCache;
+  std::vector<cv::Mat> mvPyramidBuffers;
+
   std::vector<int> mnFeaturesPerLevel;
 
   std::vector<int> umax;
@@ -1,6 +1,7 @@
 #ifndef FEATUREPOINT_H
 #define FEATUREPOINT_H
 
+#include <cstdint>
 #include <vector>
 
 //#include "DBoW2/BowVector.h"
@@ -8,12 +9,66 @@
 
 #include <fbow.h>
 
+#include "CopyOnWrite.h"
+
 #include <opencv2/opencv.hpp>
 
 namespace ORB_SLAM2 {
 
 class MapPoint;
 
+// Read-only mirror of the x, y and octave of a keypoint vector, for the grid, projection and
+// pose optimization loops. It is not the keypoint store: the cv::KeyPoint vectors stay the
+// source, and the mirror is refilled whenever they change (one extra copy per channel and frame).
+class KeyPointArray
+{
+public:
+  std::vector<float> x;
+  std::vector<float> y;
+  std::vector<int> octave;
+
+  void Assign(const std::vector<cv::KeyPoint> &vKeys);
+  void Clear();
+
+  std::size_t Size() const { return x.size(); }
+};
+
+// Keypoint indices bucketed by image cell in compressed sparse row form: the
+// keypoints of cell c = row * Cols() + col are mvIndices[mvOffsets[c], mvOffsets[c + 1]).
+// Built with one counting sort, two allocations per channel instead of one per cell.
+// The cell size follows the keypoint density (about one keypoint per cell), clamped
+// to [MIN_CELL_SIZE, MAX_CELL_SIZE] pixels.
+class FeatureGrid
+{
+public:
+  // Bucket the keypoints lying inside [minX, maxX) x [minY, maxY)
+  void Assign(const KeyPointArray &keys, const float minX, const float maxX, const float minY, const float maxY);
+  void Clear();
+
+  // Append the indices of the keypoints with |x_i - x| < r and |y_i - y| < r and, if
+  // minLevel > 0 / maxLevel >= 0, an octave in [minLevel, maxLevel]. keys are the
+  // keypoints the grid was built from.
+  void GetFeaturesInArea(const KeyPointArray &keys, const float x, const float y, const float r, const int minLevel,
+                         const int maxLevel, std::vector<std::size_t> &vIndices) const;
+
+  int Cols() const { return mnCols; }
+  int Rows() const { return mnRows; }
+
+  static const float MIN_CELL_SIZE;
+  static const float MAX_CELL_SIZE;
+
+private:
+  int mnCols = 0;
+  int mnRows = 0;
+  float mMinX = 0.0f;
+  float mMinY = 0.0f;
+  float mfCellWidthInv = 0.0f;
+  float mfCellHeightInv = 0.0f;
+
+  std::vector<std::uint32_t> mvOffsets;
+  std::vector<std::uint32_t> mvIndices;
+};
+
 class FeaturePoint
 {
 public:
@@ -24,27 +79,34 @@ public:
   // Number of Keypoints
   int N;
 
-  // Parms
-  std::vector<cv::KeyPoint> mvKeys;
-  std::vector<cv::KeyPoint> mvKeysRight;
-  std::vector<cv::KeyPoint> mvKeysUn;
+  // Extraction results. Written while the frame is built, then shared by the
+  // copies of the frame and by its keyframe (copying a channel copies pointers).
+  CopyOnWrite<std::vector<cv::KeyPoint>> mvKeys;
+  CopyOnWrite<std::vector<cv::KeyPoint>> mvKeysRight;
+  CopyOnWrite<std::vector<cv::KeyPoint>> mvKeysUn;
+
+  // Read-only mirror of mvKeysUn (x, y, octave), refilled with it in Frame::UndistortKeyPoints
+  CopyOnWrite<KeyPointArray> mKeysUnSoA;
 
-  std::vector<float> mvuRight;
-  std::vector<float> mvDepth;
+  CopyOnWrite<std::vector<float>> mvuRight;
+  CopyOnWrite<std::vector<float>> mvDepth;
   
+  // cv::Mat headers already share their data
   cv::Mat mDescriptors; 
   cv::Mat mDescriptorsRight;
 
-  std::vector<MapPoint *> mvpMapPoints;
-  std::vector<bool> mvbOutlier;
-
-  std::vector<std::vector<std::vector<std::size_t>>> mGrid;
+  // Keypoints are assigned to cells in a grid to reduce matching complexity when projecting MapPoints.
+  CopyOnWrite<FeatureGrid> mGrid;
 
   // Bag of Words std::vector structures.
   // DBoW2::BowVector mBowVec;
   // DBoW2::FeatureVector mFeatVec;
-  fbow::fBow mBowVec;
-  fbow::fBow2 mFeatVec;
+  CopyOnWrite<fbow::fBow> mBowVec;
+  CopyOnWrite<fbow::fBow2> mFeatVec;
+
+  // Association state, owned by each frame / keyframe
+  std::vector<MapPoint *> mvpMapPoints;
+  std::vector<bool> mvbOutlier;
 };
     
 }
@@ -27,22 +27,18 @@
 // #include "DBoW2/FeatureVector.h"
 #include <fbow.h>
 
+#include "ExtractorPool.h"
 #include "FeatureExtractor.h"
 #include "FeaturePoint.h"
 #include "KeyFrame.h"
 #include "MapPoint.h"
+#include "UndistortionMap.h"
 // #include "ORBVocabulary.h"
 #include "FbowVocabulary.h"
 
 #include <opencv2/opencv.hpp>
 
 namespace ORB_SLAM2 {
-#define FRAME_GRID_ROWS 48
-#define FRAME_GRID_COLS 64
-
-// #define FRAME_GRID_ROWS 14
-// #define FRAME_GRID_COLS 16
-
 class MapPoint;
 class KeyFrame;
 
@@ -54,27 +50,34 @@ public:
   // Copy constructor.
   Frame(const Frame &frame);
 
-  // Constructor for stereo cameras.
+  // Constructor for stereo cameras. Feature extraction of all channels runs on the given pool.
+  // Channels flagged in vbDeferred are left empty (N = 0) until ExtractDeferredChannels().
   Frame(const cv::Mat &imLeft, const cv::Mat &imRight, const double &timeStamp,
         std::vector<FeatureExtractor *> extractorLeft, std::vector<FeatureExtractor *> extractorRight,
-        std::vector<FbowVocabulary *> voc, cv::Mat &K, cv::Mat &distCoef, const float &bf,
-        const float &thDepth, int Ntype);
+        ExtractorPool *pool, std::vector<FbowVocabulary *> voc, cv::Mat &K, cv::Mat &distCoef, const float &bf,
+        const float &thDepth, int Ntype, const std::vector<bool> &vbDeferred = std::vector<bool>());
 
   // Constructor for RGB-D cameras.
   Frame(const cv::Mat &imGray, const cv::Mat &imDepth, const double &timeStamp,
-        std::vector<FeatureExtractor *> extractor,
+        std::vector<FeatureExtractor *> extractor, ExtractorPool *pool,
         std::vector<FbowVocabulary *> voc, cv::Mat &K, cv::Mat &distCoef, const float &bf,
-        const float &thDepth, int Ntype);
+        const float &thDepth, int Ntype, const std::vector<bool> &vbDeferred = std::vector<bool>());
 
   // Constructor for Monocular cameras.
   Frame(const cv::Mat &imGray, const double &timeStamp,
-        std::vector<FeatureExtractor *> extractor,
+        std::vector<FeatureExtractor *> extractor, ExtractorPool *pool,
         std::vector<FbowVocabulary *> voc, cv::Mat &K, cv::Mat &distCoef, const float &bf,
-        const float &thDepth, int Ntype);
+        const float &thDepth, int Ntype, const std::vector<bool> &vbDeferred = std::vector<bool>());
 
   // Extract features, Ftype: ORB(0), GCN(1), imageFlag: left image (0), right image (1).
   void ExtractFeatures(const int Ftype, int imageFlag, const cv::Mat &im);
 
+  // Channel left empty by the constructor, not extracted yet.
+  bool IsDeferred(const int Ftype) const { return !mvbDeferred.empty() && Ftype >= 0 && mvbDeferred[Ftype]; }
+
+  // Extract the deferred channels from the images kept by the constructor. Returns the channels extracted.
+  std::vector<int> ExtractDeferredChannels(ExtractorPool *pool);
+
   // Compute Bag of Words representation.
   void ComputeBoW(const int Ftype);
 
@@ -93,9 +96,6 @@ public:
   // Check if a MapPoint is in the frustum of the camera and fill variables of the MapPoint to be used by the tracking
   bool isInFrustum(MapPoint *pMP, float viewingCosLimit);
 
-  // Compute the cell of a keypoint (return false if outside the grid)
-  bool PosInGrid(const cv::KeyPoint &kp, int &posX, int &posY);
-  
   std::vector<size_t> GetFeaturesInArea(const int Ftype, const float &x, const float &y, const float &r, const int minLevel = -1,
                                         const int maxLevel = -1) const;
 
@@ -147,9 +147,8 @@ public:
   // Feature data used to store feature points
   std::vector<FeaturePoint> Channels;
 
-  // Keypoints are assigned to cells in a grid to reduce matching complexity when projecting MapPoints.
-  static float mfGridElementWidthInv;
-  static float mfGridElementHeightInv;
+  // Deferred channels (empty: every channel was extracted).
+  std::vector<bool> mvbDeferred;
 
   // Camera pose.
   cv::Mat mTcw;
@@ -176,6 +175,9 @@ public:
   static float mnMinY;
   static float mnMaxY;
 
+  // Tabulated keypoint undistortion (built with the image bounds, only with distortion).
+  static UndistortionMap mUndistortionMap;
+
   static bool mbInitialComputations;
 
 private:
@@ -188,12 +190,20 @@ private:
 
   // Assign keypoints to the grid for speed up feature matching (called in the constructor).
   void AssignFeaturesToGrid(const int Ftype);
-  void AssignFeaturesToGrid(const int &refN, const std::vector<cv::KeyPoint> &KeysUn, std::vector<std::vector<std::vector<std::size_t>>> &Grid);
 
   // compute features and assign to grids
   void ComputeFeaturesRGBD(const int Ftype, const cv::Mat &imGray, const cv::Mat &imDepth);
-  void ComputeFeaturesStereo(const int Ftype, const cv::Mat &imLeft, const cv::Mat &imRight);
+  // Stereo: left/right keypoints are extracted beforehand as separate pool tasks
+  void ComputeFeaturesStereo(const int Ftype);
   void ComputeFeaturesMono(const int Ftype, const cv::Mat &imGray); 
+
+  // Empty channel with an empty grid, so that area queries stay valid
+  void ClearChannel(const int Ftype);
+
+  // Input images, only held while some channel is deferred
+  cv::Mat mImLeft;
+  cv::Mat mImRight;
+  cv::Mat mImDepth;
   
   // Rotation, translation and camera center
   cv::Mat mRcw;
@@ -0,0 +1,59 @@
+#ifndef IMAGEPYRAMIDCACHE_H
+#define IMAGEPYRAMIDCACHE_H
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+namespace ORB_SLAM2 {
+
+/**
+ * @brief Per-frame image pyramids shared read-only by all feature channels.
+ *
+ *        One cache exists per camera image (left / right). SetImage() starts a new
+ *        frame; pyramids are then built on first request, keyed by
+ *        (scaleFactor, nLevels, border), so channels with the same pyramid settings
+ *        share a single build. The bordered level buffers are kept across frames
+ *        and only reallocated when the image size changes.
+ *
+ *        SetImage() must not overlap with Get(); Get() itself is thread safe.
+ */
+class ImagePyramidCache {
+public:
+  ImagePyramidCache();
+
+  // Start a new frame. Previously built pyramids become stale, their buffers are recycled.
+  void SetImage(const cv::Mat &image);
+
+  // True if image is the one registered for the current frame.
+  bool Holds(const cv::Mat &image);
+
+  // Pyramid of the current image. Levels are views into bordered buffers (border pixels on each side).
+  const std::vector<cv::Mat> &Get(const double scaleFactor, const int nlevels, const int border,
+                                  const std::vector<float> &vInvScaleFactor);
+
+  // Build a pyramid into the given buffers, reusing them when sizes match.
+  static void Build(const cv::Mat &image, const std::vector<float> &vInvScaleFactor, const int border,
+                    std::vector<cv::Mat> &vBuffers, std::vector<cv::Mat> &vLevels);
+
+private:
+  struct Entry {
+    std::mutex mutex;
+    unsigned long nGeneration = 0;
+    std::vector<cv::Mat> vBuffers;
+    std::vector<cv::Mat> vLevels;
+  };
+
+  std::mutex mMutex;
+  cv::Mat mImage;
+  unsigned long mnGeneration;
+  std::map<std::tuple<double, int, int>, std::unique_ptr<Entry>> mEntries;
+};
+
+} // namespace ORB_SLAM2
+
+#endif // IMAGEPYRAMIDCACHE_H
@@ -23,6 +23,7 @@
 
 // #include "DBoW2/BowVector.h"
 // #include "DBoW2/FeatureVector.h"
+#include "DescriptorIndex.h"
 #include "Frame.h"
 #include "KeyFrameDatabase.h"
 #include "MapPoint.h"
@@ -32,6 +33,7 @@
 #include <fbow.h>
 #include "FbowVocabulary.h"
 
+#include <memory>
 #include <mutex>
 
 namespace ORB_SLAM2 {
@@ -57,6 +59,10 @@ public:
   // Bag of Words Representation
   void ComputeBoW(const int Ftype);
 
+  // Approximate nearest neighbour index over the channel descriptors, built by LocalMapping next to
+  // the BoW vectors (or on the first query if it has not run yet) and released when the keyframe is set bad
+  std::shared_ptr<const DescriptorIndex> GetDescriptorIndex(const int Ftype);
+
   // Covisibility graph functions
   void AddConnection(KeyFrame *pKF, const int &weight);
   void EraseConnection(KeyFrame *pKF);
@@ -135,12 +141,6 @@ public:
 
   const double mTimeStamp;
 
-  // Grid (to speed up feature matching)
-  const int mnGridCols;
-  const int mnGridRows;
-  const float mfGridElementWidthInv;
-  const float mfGridElementHeightInv;
-
   // Variables used by the tracking
   long unsigned int mnTrackReferenceForFrame;
   long unsigned int mnFuseTargetForKF;
@@ -199,6 +199,9 @@ protected:
   //std::vector<ORBVocabulary *> mpVocabulary;
   std::vector<FbowVocabulary *> mpVocabulary;
 
+  // Descriptor indices, per channel
+  std::vector<std::shared_ptr<const DescriptorIndex>> mvpDescriptorIndex;
+
   // Connected keyframe variables
   std::map<KeyFrame *, int> mConnectedKeyFrameWeights;
   std::vector<KeyFrame *> mvpOrderedConnectedKeyFrames;
@@ -222,6 +225,7 @@ protected:
   std::mutex mMutexPose;
   std::mutex mMutexConnections;
   std::mutex mMutexFeatures;
+  std::mutex mMutexDescriptorIndex;
 };
 
 } // namespace ORB_SLAM2
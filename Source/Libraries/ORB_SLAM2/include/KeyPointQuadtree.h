@@ -0,0 +1,97 @@
+#ifndef KEYPOINTQUADTREE_H
+#define KEYPOINTQUADTREE_H
+
+#include <utility>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+namespace ORB_SLAM2 {
+
+/**
+ * @brief Quadtree distribution of keypoints over an image level (ORB-SLAM2 "octree").
+ *
+ *        The region is split into square-ish initial nodes, and nodes holding more
+ *        than one keypoint are split in four until there are at least N nodes or no
+ *        node can be split further. The best keypoint of every node is retained.
+ *
+ *        Nodes are index ranges into one permutation of the input keypoints and are
+ *        split by in-place partitioning, so keypoints are never copied. The node
+ *        arena and the index buffers belong to the object and are reset on every
+ *        call, keeping their capacity: after the first frames a call allocates
+ *        nothing but the output. One object per extractor, not thread safe.
+ *
+ *        Keypoint coordinates are relative to (minX, minY).
+ */
+class KeyPointQuadtree {
+public:
+  // Higher response is better (ORB-SLAM2)
+  struct ResponseGreater {
+    bool operator()(const cv::KeyPoint &a, const cv::KeyPoint &b) const { return a.response > b.response; }
+  };
+
+  // Distribute keys and write the best keypoint of each final node to vResultKeys.
+  // better(a, b) returns true if a should be retained over b.
+  template <class Better>
+  void Distribute(const std::vector<cv::KeyPoint> &vKeys, const int minX, const int maxX, const int minY,
+                  const int maxY, const int N, std::vector<cv::KeyPoint> &vResultKeys, Better better);
+
+  void Distribute(const std::vector<cv::KeyPoint> &vKeys, const int minX, const int maxX, const int minY,
+                  const int maxY, const int N, std::vector<cv::KeyPoint> &vResultKeys) {
+    Distribute(vKeys, minX, maxX, minY, maxY, N, vResultKeys, ResponseGreater());
+  }
+
+private:
+  struct Node {
+    int begin, end;         // range in mvIndices
+    int minX, maxX, minY, maxY;
+    bool bNoMore;
+    bool bAlive;
+  };
+
+  // Build the tree, leaves the final nodes in mvActive (dead entries have bAlive == false)
+  void Build(const std::vector<cv::KeyPoint> &vKeys, const int minX, const int maxX, const int minY,
+             const int maxY, const int N);
+
+  // Split a node in four, push the non-empty children to mvActive and the splittable ones to vExpand
+  void Divide(const std::vector<cv::KeyPoint> &vKeys, const int node, std::vector<std::pair<int, int>> &vExpand);
+
+  std::vector<Node> mvNodes;
+  std::vector<int> mvIndices;
+  std::vector<int> mvBucket;
+  std::vector<int> mvActive;
+  std::vector<int> mvNext;
+  int mnActive = 0;
+
+  std::vector<std::pair<int, int>> mvExpand;
+  std::vector<std::pair<int, int>> mvPrevExpand;
+};
+
+template <class Better>
+void KeyPointQuadtree::Distribute(const std::vector<cv::KeyPoint> &vKeys, const int minX, const int maxX,
+                                  const int minY, const int maxY, const int N,
+                                  std::vector<cv::KeyPoint> &vResultKeys, Better better) {
+  vResultKeys.clear();
+  if (vKeys.empty())
+    return;
+
+  Build(vKeys, minX, maxX, minY, maxY, N);
+
+  vResultKeys.reserve(mnActive);
+  for (const int node : mvActive) {
+    const Node &n = mvNodes[node];
+    if (!n.bAlive)
+      continue;
+
+    int best = mvIndices[n.begin];
+    for (int k = n.begin + 1; k < n.end; k++) {
+      if (better(vKeys[mvIndices[k]], vKeys[best]))
+        best = mvIndices[k];
+    }
+    vResultKeys.push_back(vKeys[best]);
+  }
+}
+
+} // namespace ORB_SLAM2
+
+#endif // KEYPOINTQUADTREE_H
@@ -0,0 +1,42 @@
+#ifndef LOCALMAPDESCRIPTORS_H
+#define LOCALMAPDESCRIPTORS_H
+
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+namespace ORB_SLAM2 {
+
+class MapPoint;
+
+/**
+ * @brief Descriptors of the local map points, one contiguous matrix per channel.
+ *
+ *        Update() is called by Tracking whenever the local map is rebuilt. While the
+ *        points of a channel stay the same, in the same order, only the rows whose
+ *        descriptor changed since (MapPoint::GetDescriptorVersion, e.g. recomputed by
+ *        LocalMapping) are copied again. The projection matcher then reads rows of the
+ *        block directly, without taking the map point mutex or cloning a cv::Mat.
+ *
+ *        Get() only reads: concurrent channel searches can share the object.
+ */
+class LocalMapDescriptors {
+public:
+  void Update(const std::vector<MapPoint *> &vpLocalMapPoints, const int Ntype);
+
+  // Descriptor row of pMP, NULL when the point is not in the local map
+  const uchar *Get(MapPoint *pMP) const;
+
+private:
+  // Per channel: descriptor rows, the point owning each row and the descriptor version copied
+  std::vector<cv::Mat> mvDescriptors;
+  std::vector<std::vector<MapPoint *>> mvvpMapPoints;
+  std::vector<std::vector<unsigned int>> mvvVersions;
+
+  // Version of a row without descriptor
+  static const unsigned int INVALID_VERSION;
+};
+
+} // namespace ORB_SLAM2
+
+#endif // LOCALMAPDESCRIPTORS_H
@@ -0,0 +1,46 @@
+#ifndef LOCALMAPSNAPSHOT_H
+#define LOCALMAPSNAPSHOT_H
+
+#include <vector>
+
+namespace ORB_SLAM2 {
+
+class Frame;
+class MapPoint;
+
+/**
+ * @brief Copy of the local map geometry taken once per frame, for batch visibility tests.
+ *
+ *        Assign() reads the position, normal and scale invariance distances of every
+ *        point under a single lock per point and stores them in contiguous float
+ *        arrays, grouped by feature channel. Cull() then runs Frame::isInFrustum on a
+ *        whole channel: projection, depth, image bounds, distance and viewing angle
+ *        tests eight points at a time (AVX2 when the CPU has it, portable otherwise),
+ *        and only the visible points get their scale predicted and their tracking
+ *        variables (mbTrackInView, mTrackProjX, ...) written.
+ *
+ *        Cull() only reads the snapshot: the channels can be culled concurrently.
+ */
+class LocalMapSnapshot {
+public:
+  // Snapshot vpMapPoints, grouped by channel. Points without a channel are skipped.
+  void Assign(const std::vector<MapPoint *> &vpMapPoints, const int Ntype);
+
+  int Size(const int Ftype) const { return mvOffsets[Ftype + 1] - mvOffsets[Ftype]; }
+
+  // Frame::isInFrustum for the points of channel Ftype, appends the visible ones to vpVisible
+  void Cull(Frame &F, const int Ftype, const float viewingCosLimit, std::vector<MapPoint *> &vpVisible) const;
+
+private:
+  std::vector<int> mvOffsets;
+  std::vector<MapPoint *> mvpMapPoints;
+
+  // Position, normal and scale invariance distances (mfMinDistance, mfMaxDistance)
+  std::vector<float> mvX, mvY, mvZ;
+  std::vector<float> mvNx, mvNy, mvNz;
+  std::vector<float> mvMinDistance, mvMaxDistance;
+};
+
+} // namespace ORB_SLAM2
+
+#endif // LOCALMAPSNAPSHOT_H
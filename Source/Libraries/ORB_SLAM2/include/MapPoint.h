@@ -25,6 +25,7 @@
 #include "KeyFrame.h"
 #include "Map.h"
 
+#include <atomic>
 #include <mutex>
 #include <opencv2/core/core.hpp>
 #include <unordered_map>
@@ -48,6 +49,9 @@ public:
   cv::Mat GetNormal();
   KeyFrame *GetReferenceKeyFrame();
 
+  // Position, normal and scale invariance distances (mfMinDistance, mfMaxDistance) under one lock
+  void GetGeometry(float *pPos, float *pNormal, float &minDistance, float &maxDistance);
+
   std::map<KeyFrame *, std::size_t> GetObservations();
   int Observations();
 
@@ -72,6 +76,9 @@ public:
 
   cv::Mat GetDescriptor();
 
+  // Incremented every time the descriptor is recomputed, read without lock
+  unsigned int GetDescriptorVersion() const { return mnDescriptorVersion.load(std::memory_order_acquire); }
+
   void UpdateNormalAndDepth();
 
   float GetMinDistanceInvariance();
@@ -85,6 +92,8 @@ public:
   // CorrelationEdge Related
   uint32_t AddEdge(MapPoint *pOther);
   uint32_t GetEdgeCount(MapPoint *pOther) const;
+  // Points of the other channels linked by an edge counted at least th_str times
+  std::vector<MapPoint *> GetCorrelatedPoints(const uint32_t th_str) const;
 
 public:
   long unsigned int mnId;
@@ -105,6 +114,7 @@ public:
   float mTrackViewCos;
   long unsigned int mnTrackReferenceForFrame;
   long unsigned int mnLastFrameSeen;
+  int mnTrackDescriptorRow;
 
   // Variables used by local mapping
   long unsigned int mnBALocalForKF;
@@ -134,6 +144,7 @@ protected:
 
   // Best descriptor to fast matching
   cv::Mat mDescriptor;
+  std::atomic<unsigned int> mnDescriptorVersion;
 
   // Reference KeyFrame
   KeyFrame *mpRefKF;
@@ -22,23 +22,11 @@
 #define ORBEXTRACTOR_H
 
 #include "FeatureExtractor.h"
+#include "KeyPointQuadtree.h"
 #include <opencv2/opencv.hpp>
 
 namespace ORB_SLAM2 {
 
-class ExtractorNode {
-public:
-  ExtractorNode() : bNoMore(false) {}
-
-  void DivideNode(ExtractorNode &n1, ExtractorNode &n2, ExtractorNode &n3,
-                  ExtractorNode &n4);
-
-  std::vector<cv::KeyPoint> vKeys;
-  cv::Point2i UL, UR, BL, BR;
-  std::list<ExtractorNode>::iterator lit;
-  bool bNoMore;
-};
-
 class ORBextractor : public FeatureExtractor {
 public:
   ORBextractor(int nfeatures, float scaleFactor, int nlevels, int iniThFAST, int minThFAST);
@@ -58,14 +46,18 @@ public:
 
    static void ForceLinking();
 
+  // Orientation and rBRIEF stages alone, on keypoints given in the coordinates of image, with the
+  // kernels operator() runs (bench_extractors --simd compares the AVX2 and scalar paths)
+  void ComputeOrientation(const cv::Mat &image, std::vector<cv::KeyPoint> &keypoints) const;
+  void ComputeDescriptors(const cv::Mat &image, std::vector<cv::KeyPoint> &keypoints, cv::Mat &descriptors) const;
+
 protected:
   void ComputePyramid(cv::Mat image);
   void
   ComputeKeyPointsOctTree(std::vector<std::vector<cv::KeyPoint>> &allKeypoints);
-  std::vector<cv::KeyPoint>
-  DistributeOctTree(const std::vector<cv::KeyPoint> &vToDistributeKeys,
-                    const int &minX, const int &maxX, const int &minY,
-                    const int &maxY, const int &nFeatures, const int &level);
+
+  // Keypoint distribution, node arena reused across levels and frames
+  KeyPointQuadtree mQuadtree;
 
   void
   ComputeKeyPointsOld(std::vector<std::vector<cv::KeyPoint>> &allKeypoints);
@@ -21,6 +21,9 @@ class SIFTextractor : public FeatureExtractor {
         void InfoConfigs() override;
         static void ForceLinking();
 
+        // cv::SIFT caps keypoints before computing descriptors, it is rebuilt with the new budget
+        void SetNumFeatures(int n) override;
+
     private:
         cv::Ptr<cv::SIFT> mpSIFT;
         int edgeThreshold;
@@ -24,11 +24,14 @@
 #ifndef SUPERPOINT_H
 #define SUPERPOINT_H
 
+#include <torch/script.h>
 #include <torch/torch.h>
 
 #include <opencv2/opencv.hpp>
 #include <vector>
 
+#include "SuperPointDetector.h"
+
 #ifdef EIGEN_MPL2_ONLY
 #undef EIGEN_MPL2_ONLY
 #endif
@@ -60,25 +63,49 @@ struct SuperPoint : torch::nn::Module {
   torch::nn::Conv2d convDb;
 };
 
+// Dense outputs from the raw heads: semi [B, 65, H/8, W/8] -> probability
+// map [B, H, W], desc [B, 256, H/8, W/8] -> L2-normalized descriptors.
+std::vector<torch::Tensor> decodeHeads(torch::Tensor semi, torch::Tensor desc);
+
 // cv::Mat SPdetect(std::shared_ptr<SuperPoint> model, cv::Mat img,
 // std::vector<cv::KeyPoint> &keypoints, double threshold, bool nms, bool cuda);
 //  torch::Tensor NMS(torch::Tensor kpts);
 
-class SPDetector {
+class SPDetector : public SPDetectorBase {
  public:
-  SPDetector(std::shared_ptr<SuperPoint> _model, bool cuda);
-  void detect(cv::Mat& image);
-  void getKeyPoints(float threshold, int iniX, int maxX, int iniY, int maxY,
-                    std::vector<cv::KeyPoint>& keypoints, bool nms);
+  SPDetector(std::shared_ptr<SuperPoint> _model, bool cuda,
+             bool channelsLast = false);
+  // TorchScript SuperPoint whose forward returns the raw (semi, desc) heads,
+  // e.g. a traced SuperPointNet (fp32) or a statically quantized one (int8).
+  // The module is frozen and optimized for inference.
+  SPDetector(torch::jit::script::Module _module, bool cuda,
+             bool channelsLast = false);
+  void detect(cv::Mat& image) override;
+  void detectMosaic(const std::vector<cv::Mat>& images) override;
+  void selectLevel(int level) override;
+  void getKeyPoints(float iniThreshold, float minThreshold,
+                    int iniX, int maxX, int iniY, int maxY,
+                    int wCell, int hCell,
+                    std::vector<cv::KeyPoint>& keypoints, bool nms) override;
   void computeDescriptors(const std::vector<cv::KeyPoint>& keypoints,
-                          cv::Mat& descriptors);
+                          cv::Mat& descriptors) override;
 
  private:
+  void forward(const cv::Mat& image);
+
   std::shared_ptr<SuperPoint> model;
+  torch::jit::script::Module mModule;
+  bool mbScripted;
+  bool mbChannelsLast;
   torch::Tensor mProb;
   torch::Tensor mDesc;
   torch::DeviceType m_device;
   torch::Tensor mProbCPU;
+
+  // Per-image views into the mosaic outputs of detectMosaic()
+  std::vector<torch::Tensor> mvProb;
+  std::vector<torch::Tensor> mvDesc;
+  std::vector<torch::Tensor> mvProbCPU;
 };
 
 }  // namespace SuperSLAM
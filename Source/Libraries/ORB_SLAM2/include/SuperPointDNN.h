@@ -0,0 +1,77 @@
+/**
+ * >>> OpenCV DNN port of SuperSLAM::SPDetector <<<
+ *  By Howard Cui <haoyangcui at outlook dot com>
+ *
+ * This file is part of SuperSLAM.
+ *
+ * Copyright (C) Aditya Wagh <adityamwagh at outlook dot com>
+ * For more information see <https://github.com/adityamwagh/SuperSLAM>
+ *
+ * SuperSLAM is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SuperSLAM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SuperSLAM. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SUPERPOINTDNN_H
+#define SUPERPOINTDNN_H
+
+#include <opencv2/dnn.hpp>
+#include <string>
+#include <vector>
+
+#include "SuperPointDetector.h"
+
+namespace SuperSLAM {
+
+// SuperPoint on cv::dnn, no LibTorch involved. The ONNX model takes a
+// [1, 1, H, W] float image in [0, 1] (dynamic H and W) and returns the raw
+// heads semi [1, 65, H/8, W/8] and desc [1, 256, H/8, W/8]. Decoding matches
+// decodeHeads() and SPDetector::computeDescriptors().
+class SPDetectorDNN : public SPDetectorBase {
+ public:
+  SPDetectorDNN(const std::string& onnxPath, bool cuda);
+
+  void detect(cv::Mat& image) override;
+  void detectMosaic(const std::vector<cv::Mat>& images) override;
+  void selectLevel(int level) override;
+  void getKeyPoints(float iniThreshold, float minThreshold,
+                    int iniX, int maxX, int iniY, int maxY,
+                    int wCell, int hCell,
+                    std::vector<cv::KeyPoint>& keypoints, bool nms) override;
+  void computeDescriptors(const std::vector<cv::KeyPoint>& keypoints,
+                          cv::Mat& descriptors) override;
+
+ private:
+  void forward(const cv::Mat& image);
+
+  cv::dnn::Net mNet;
+  std::vector<cv::String> mvOutNames;
+  std::vector<cv::Mat> mvOuts;
+  cv::Mat mBlob;
+
+  // Dense outputs of the last forward pass: probability map [H, W] and
+  // L2-normalized descriptors [1, 256, H/8, W/8]
+  cv::Mat mProbAll;
+  cv::Mat mDescAll;
+
+  // Active image, views into the above
+  cv::Mat mProb;
+  cv::Mat mDesc;
+
+  // Per-image views into the mosaic outputs of detectMosaic()
+  std::vector<cv::Mat> mvProb;
+  std::vector<cv::Mat> mvDesc;
+};
+
+}  // namespace SuperSLAM
+
+#endif
@@ -0,0 +1,76 @@
+/**
+ * >>> Part of the modified SuperSLAM SuperPoint detector <<<
+ *  By Howard Cui <haoyangcui at outlook dot com>
+ *
+ * This file is part of SuperSLAM.
+ *
+ * Copyright (C) Aditya Wagh <adityamwagh at outlook dot com>
+ * For more information see <https://github.com/adityamwagh/SuperSLAM>
+ *
+ * SuperSLAM is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SuperSLAM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SuperSLAM. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SUPERPOINTDETECTOR_H
+#define SUPERPOINTDETECTOR_H
+
+#include <opencv2/core/core.hpp>
+#include <vector>
+
+namespace SuperSLAM {
+
+// Inference-independent part of a SuperPoint detector. Implemented on
+// LibTorch (SPDetector) and on OpenCV DNN (SPDetectorDNN); both produce the
+// same dense probability map and descriptor grid, so keypoints and
+// descriptors are interchangeable.
+class SPDetectorBase {
+ public:
+  virtual ~SPDetectorBase() {}
+
+  virtual void detect(cv::Mat& image) = 0;
+  // Run all images (pyramid levels) through a single forward pass by tiling
+  // them into one mosaic; use selectLevel() to pick the active image.
+  virtual void detectMosaic(const std::vector<cv::Mat>& images) = 0;
+  virtual void selectLevel(int level) = 0;
+  // Threshold + NMS over [iniX, maxX) x [iniY, maxY) of the active image in a
+  // single pass. The area is split in wCell x hCell cells: a cell keeps its
+  // points above iniThreshold, or above minThreshold if it has none.
+  // Keypoint coordinates are relative to (iniX, iniY).
+  virtual void getKeyPoints(float iniThreshold, float minThreshold,
+                            int iniX, int maxX, int iniY, int maxY,
+                            int wCell, int hCell,
+                            std::vector<cv::KeyPoint>& keypoints,
+                            bool nms) = 0;
+  virtual void computeDescriptors(const std::vector<cv::KeyPoint>& keypoints,
+                                  cv::Mat& descriptors) = 0;
+
+ protected:
+  // Tile images into one 8-aligned mosaic (see detectMosaic)
+  static void packMosaic(const std::vector<cv::Mat>& images, cv::Mat& mosaic,
+                         std::vector<cv::Rect>& vTiles);
+
+  // getKeyPoints() on a [height, width] view of the probability map
+  void selectKeyPoints(const cv::Mat& prob, float iniThreshold,
+                       float minThreshold, int wCell, int hCell,
+                       std::vector<cv::KeyPoint>& keypoints, bool nms);
+
+ private:
+  // Scratch buffers of selectKeyPoints(), reused between calls
+  cv::Mat mProbMax;
+  std::vector<std::vector<cv::KeyPoint>> mvCellKeys;
+  std::vector<char> mvCellStrong;
+};
+
+}  // namespace SuperSLAM
+
+#endif
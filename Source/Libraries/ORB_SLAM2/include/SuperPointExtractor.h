@@ -27,16 +27,19 @@
 #pragma once
 #include "FeatureExtractor.h"
 #include "SuperPoint.h"
+#include "SuperPointDNN.h"
 #include "FeatureExtractorFactory.h"
+#include "KeyPointQuadtree.h"
 #include <memory>
 #include <string>
-#include <list>
 
 namespace ORB_SLAM2 {
 
     class SuperPointExtractor : public FeatureExtractor {
     public:
-        SuperPointExtractor(const cv::FileNode& cfg, bool init);
+        // A non-empty backend overrides the 'backend' key of cfg
+        SuperPointExtractor(const cv::FileNode& cfg, bool init,
+                            const std::string& backend = std::string());
 
         void InfoConfigs() override;
 
@@ -48,29 +51,20 @@ namespace ORB_SLAM2 {
         static void ForceLinking();
 
     private:
-        struct ExtractorNode {
-            std::vector<cv::KeyPoint> vKeys;
-            cv::Point2i UL, UR, BL, BR;
-            std::list<ExtractorNode>::iterator lit;
-            bool bNoMore = false;
-
-            void DivideNode(ExtractorNode& n1, ExtractorNode& n2,
-                            ExtractorNode& n3, ExtractorNode& n4);
-        };
-
-        std::vector<cv::KeyPoint> DistributeOctTree(
-            const std::vector<cv::KeyPoint>& vToDistributeKeys,
-            const int& minX, const int& maxX, const int& minY, const int& maxY,
-            const int& nFeatures, const int& level);
-
-    private:
-		std::unique_ptr<SuperSLAM::SPDetector> mDetector;
+		std::unique_ptr<SuperSLAM::SPDetectorBase> mDetector;
         std::shared_ptr<SuperSLAM::SuperPoint> mModel;
         float iniTh;
         float minTh;
         bool  mUseCUDA = false;
         bool  mUseNMS = true;
+        bool  mBatchLevels = false;
+        bool  mChannelsLast = false;
         std::string mWeightsPath;
+        std::string mBackend;
+        std::string mModelPath;
+
+        // Keypoint distribution, node arena reused across levels and frames
+        KeyPointQuadtree mQuadtree;
     };
 
 } // namespace ORB_SLAM2
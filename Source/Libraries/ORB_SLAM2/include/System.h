@@ -201,6 +201,10 @@ private:
   std::vector<MapPoint *> mTrackedMapPoints;
   std::vector<cv::KeyPoint> mTrackedKeyPointsUn;
   std::mutex mMutexState;
+
+  // Pin the calling thread to the tracking cores, once per thread feeding frames
+  void PinTrackingThread();
+  std::thread::id mTrackingThreadId;
 };
 
 } // namespace ORB_SLAM2
@@ -0,0 +1,33 @@
+#ifndef THREADBUDGET_H
+#define THREADBUDGET_H
+
+#include <opencv2/core/core.hpp>
+
+namespace ORB_SLAM2 {
+namespace ThreadBudget {
+
+/**
+ * @brief Process-wide CPU budget, read from the "ThreadBudget" settings node.
+ *
+ *        Sizes the extraction pool and the LibTorch / OpenCV internal pools so
+ *        that they do not each claim the whole machine, and optionally pins the
+ *        SLAM threads to disjoint core sets laid out from first_core on:
+ *        [tracking + extraction][mapping][loop closing + global BA].
+ *        Missing keys keep the library defaults.
+ */
+enum Role { TRACKING = 0, MAPPING = 1, LOOP_CLOSING = 2 };
+
+// Read the budget and configure the LibTorch / OpenCV pools. Call once, before
+// the extractors are created.
+void init(const cv::FileNode &node);
+
+// Worker count for ExtractorPool (0: let the pool size itself)
+int extractionThreads();
+
+// Pin the calling thread to the cores of its role (no-op unless affinity is on)
+void pinCurrentThread(Role role);
+
+} // namespace ThreadBudget
+} // namespace ORB_SLAM2
+
+#endif // THREADBUDGET_H
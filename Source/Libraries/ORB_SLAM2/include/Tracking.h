@@ -24,11 +24,15 @@
 #include <opencv2/core/core.hpp>
 #include <opencv2/features2d/features2d.hpp>
 
+#include "ExtractorPool.h"
+#include "FeatureBudget.h"
 #include "FeatureExtractor.h"
 #include "Frame.h"
 #include "FrameDrawer.h"
 #include "Initializer.h"
 #include "KeyFrameDatabase.h"
+#include "LocalMapDescriptors.h"
+#include "LocalMapSnapshot.h"
 #include "LocalMapping.h"
 #include "LoopClosing.h"
 #include "Map.h"
@@ -155,6 +159,14 @@ protected:
   void DiscardUnobservedMappoints(Frame &F, const int Ftype);
   void DiscardOutliersMappoints(Frame &F, const int Ftype);
 
+  // Feed the last frame to the feature budget and resize the extractors if it moved
+  void UpdateFeatureBudget(const bool bOK);
+
+  // Lazy extraction: channels to leave out of the next frame (empty: extract all)
+  std::vector<bool> DeferredChannels() const;
+  // Extract the deferred channels of the current frame and match them against the local map
+  void CompleteDeferredChannels();
+
 
   // In case of performing only localization, this flag is true when there are no matches to points in the map. Still tracking will continue if there are
   // enough matches with temporal points. In that case we are doing visual odometry. The system will try to do relocalization to recover "zero-drift"
@@ -178,6 +190,33 @@ protected:
   std::vector<FeatureExtractor *> mpIniFeatureExtractor;
   //FeatureExtractor *mpFeatureExtractor[Ntype];
 
+  // Worker threads running the per-channel extraction of every frame
+  ExtractorPool *mpExtractorPool;
+
+  // Per-channel nFeatures controller (driven by inlier yield and extraction cost)
+  FeatureBudget *mpFeatureBudget;
+
+  // Lazy extraction: secondary channels are only extracted on keyframe candidates, and on every
+  // frame while the primary channels track fewer than mnLazyMinInliers inliers
+  bool mbLazyExtraction;
+  std::vector<bool> mvbSecondaryChannel;
+  int mnLazyMinInliers;
+  bool mbExtractAllNext;
+
+  // Correlation-guided search: strong cross-channel partners (edge counter >= mnCorrelationStrength)
+  // of the points already matched are searched within mfCorrelationRadius pixels of the match
+  bool mbCorrelationSearch;
+  float mfCorrelationRadius;
+  int mnCorrelationStrength;
+
+  // Relocalization candidates with too few BoW matches are matched again through the keyframe
+  // descriptor index (Associater::SearchByIndex)
+  bool mbRelocalizationIndex;
+
+  // Image pyramids shared by the channels of the left and right images
+  ImagePyramidCache *mpPyramidCacheLeft;
+  ImagePyramidCache *mpPyramidCacheRight;
+
   // BoW
   std::vector<FbowVocabulary *> mpVocabulary;
   std::vector<KeyFrameDatabase *> mpKeyFrameDB;
@@ -195,6 +234,12 @@ protected:
   std::vector<KeyFrame *> mvpLocalKeyFrames;
   std::vector<MapPoint *> mvpLocalMapPoints;
 
+  // Geometry of the local map points searched in the current frame (buffers reused across frames)
+  LocalMapSnapshot mLocalMapSnapshot;
+
+  // Descriptors of the local map points, per channel, kept while the local map does not change
+  LocalMapDescriptors mLocalMapDescriptors;
+
   // System
   System *mpSystem;
 
@@ -224,6 +269,7 @@ protected:
 
   // Current matches in frame
   int mnMatchesInliers;
+  std::vector<int> mvnMatchesInliers;
 
   // Last Frame, KeyFrame and Relocalisation Info
   KeyFrame *mpLastKeyFrame;
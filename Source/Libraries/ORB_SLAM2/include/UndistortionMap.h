@@ -0,0 +1,50 @@
+#ifndef UNDISTORTIONMAP_H
+#define UNDISTORTIONMAP_H
+
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+namespace ORB_SLAM2 {
+
+/**
+ * @brief Tabulated undistortion of one camera, for fixed calibration.
+ *
+ *        cv::undistortPoints solves the inverse distortion iteratively for every
+ *        point. Here it runs once, on a lattice of nodes spanning [0, cols] x
+ *        [0, rows] (about one node every STEP pixels, the last node exactly on the
+ *        image border), and points are then undistorted by bilinear interpolation
+ *        of the table. Outside the image the border cells are extrapolated
+ *        linearly.
+ *
+ *        With STEP = 4 the interpolation error is of the order of 0.01 px even for
+ *        wide-angle k1 / k2 / k3, and the table of a 640x480 image is about 150 KB.
+ */
+class UndistortionMap {
+public:
+  // Tabulate the undistortion of (K, distCoef) over a cols x rows image
+  void Create(const cv::Mat &K, const cv::Mat &distCoef, const int cols, const int rows);
+
+  bool IsEmpty() const { return mvX.empty(); }
+
+  // Undistort n points in place
+  void Undistort(float *pX, float *pY, const int n) const;
+
+  cv::Point2f Undistort(const float x, const float y) const;
+
+  static const int STEP;
+
+private:
+  int mnNodesX = 0;
+  int mnNodesY = 0;
+  float mfInvStepX = 0.0f;
+  float mfInvStepY = 0.0f;
+
+  // Undistorted coordinates of node (i, j) at j * mnNodesX + i
+  std::vector<float> mvX;
+  std::vector<float> mvY;
+};
+
+} // namespace ORB_SLAM2
+
+#endif // UNDISTORTIONMAP_H
@@ -1,5 +1,8 @@
 #include "Associater.h"
+#include "DescriptorIndex.h"
+#include "DescriptorMetric.h"
 
+#include <cfloat>
 #include <limits.h>
 
 // #include "DBoW2/FeatureVector.h"
@@ -14,6 +17,9 @@ namespace ORB_SLAM2 {
 //const int Associater::TH_HIGH = 100;
 //const int Associater::TH_LOW = 50;
 const int Associater::HISTO_LENGTH = 30;
+const int Associater::INDEX_KNN = 2;
+const float Associater::NN_RADIUS = 15.0f;
+const size_t Associater::NN_EXHAUSTIVE_PAIRS = 1 << 18;
 std::vector<float> Associater::mvTH_LOW;
 std::vector<float> Associater::mvTH_HIGH;
 
@@ -22,7 +28,9 @@ Associater::Associater(float nnratio, bool checkOri)
 
 // Rewrite, it should be used in the trackmotionmodel
 int Associater::SearchByProjection(Frame &CurrentFrame, const Frame &LastFrame, const float th, const bool bMono, const int Ftype) {
-  
+  const DescriptorMetric descriptorDistance(CurrentFrame.Channels[Ftype].mDescriptors);
+  vector<size_t> vCandidates;
+
   int nmatches = 0;
   
   // step 1 build rotation histogram (to check rotation consistency)
@@ -95,9 +103,7 @@ int Associater::SearchByProjection(Frame &CurrentFrame, const Frame &LastFrame,
 
         const cv::Mat dMP = pMP->GetDescriptor();
 
-        float bestDist = 3.40282e+38f;
-        int bestIdx2 = -1;
-
+        vCandidates.clear();
         for (vector<size_t>::const_iterator vit = vIndices2.begin(), vend = vIndices2.end(); vit != vend; vit++) {
           const size_t i2 = *vit;
           if (CurrentFrame.Channels[Ftype].mvpMapPoints[i2])
@@ -111,16 +117,14 @@ int Associater::SearchByProjection(Frame &CurrentFrame, const Frame &LastFrame,
               continue;
           }
 
-          const cv::Mat &d = CurrentFrame.Channels[Ftype].mDescriptors.row(i2);
-
-          const float dist = DescriptorDistance(dMP, d);
-
-          if (dist < bestDist) {
-            bestDist = dist;
-            bestIdx2 = i2;
-          }
+          vCandidates.push_back(i2);
         }
 
+        const DescriptorMatch match = descriptorDistance.Match(dMP.data, CurrentFrame.Channels[Ftype].mDescriptors,
+                                                               vCandidates.data(), vCandidates.size());
+        const float bestDist = match.bestDist;
+        const int bestIdx2 = match.bestIdx;
+
         if (bestDist <= mvTH_HIGH[Ftype]) {
           CurrentFrame.Channels[Ftype].mvpMapPoints[bestIdx2] = pMP;
           nmatches++;
@@ -162,11 +166,17 @@ int Associater::SearchByProjection(Frame &CurrentFrame, const Frame &LastFrame,
 }
 
 // used in trackwithlocalmap
-int Associater::SearchByProjection(Frame &F, const vector<MapPoint*> &vpMapPoints, const float th) {
+int Associater::SearchByProjection(Frame &F, const vector<MapPoint*> &vpMapPoints, const float th,
+                                   const LocalMapDescriptors *pLocalDescriptors) {
   int nmatches = 0;
 
   const bool bFactor = th != 1.0;
 
+  vector<DescriptorMetric> vDescriptorDistance;
+  for (int Ftype = 0; Ftype < F.Ntype; Ftype++)
+    vDescriptorDistance.push_back(DescriptorMetric(F.Channels[Ftype].mDescriptors));
+  vector<size_t> vCandidates;
+
   for (size_t iMP = 0; iMP < vpMapPoints.size(); iMP++) {
     MapPoint *pMP = vpMapPoints[iMP];
     if (!pMP->mbTrackInView)
@@ -193,15 +203,15 @@ int Associater::SearchByProjection(Frame &F, const vector<MapPoint*> &vpMapPoint
     if (vIndices.empty())
       continue;
 
-    const cv::Mat MPdescriptor = pMP->GetDescriptor();
-
-    float bestDist = 3.40282e+38f;
-    int bestLevel = -1;
-    float bestDist2 = 3.40282e+38f;
-    int bestLevel2 = -1;
-    int bestIdx = -1;
+    // Row of the local map snapshot: no lock and no copy
+    const uchar *pMPdescriptor = pLocalDescriptors ? pLocalDescriptors->Get(pMP) : NULL;
+    cv::Mat MPdescriptor;
+    if (!pMPdescriptor) {
+      MPdescriptor = pMP->GetDescriptor();
+      pMPdescriptor = MPdescriptor.data;
+    }
 
-    // Get best and second matches with near keypoints
+    vCandidates.clear();
     for (vector<size_t>::const_iterator vit = vIndices.begin(), vend = vIndices.end(); vit != vend; vit++) {
       const size_t idx = *vit;
 
@@ -215,22 +225,19 @@ int Associater::SearchByProjection(Frame &F, const vector<MapPoint*> &vpMapPoint
           continue;
       }
 
-      const cv::Mat &d = F.Channels[Ftype].mDescriptors.row(idx);
-
-      const float dist = DescriptorDistance(MPdescriptor, d);
-
-      if (dist < bestDist) {
-        bestDist2 = bestDist;
-        bestDist = dist;
-        bestLevel2 = bestLevel;
-        bestLevel = F.Channels[Ftype].mvKeysUn[idx].octave;
-        bestIdx = idx;
-      } else if (dist < bestDist2) {
-        bestLevel2 = F.Channels[Ftype].mvKeysUn[idx].octave;
-        bestDist2 = dist;
-      }
+      vCandidates.push_back(idx);
     }
 
+    // Get best and second matches with near keypoints
+    const DescriptorMatch match = vDescriptorDistance[Ftype].Match(pMPdescriptor, F.Channels[Ftype].mDescriptors,
+                                                                   vCandidates.data(), vCandidates.size());
+    const float bestDist = match.bestDist;
+    const float bestDist2 = match.secondDist;
+    const int bestIdx = match.bestIdx;
+    const int *pOctave = F.Channels[Ftype].mKeysUnSoA->octave.data();
+    const int bestLevel = match.bestIdx >= 0 ? pOctave[match.bestIdx] : -1;
+    const int bestLevel2 = match.secondIdx >= 0 ? pOctave[match.secondIdx] : -1;
+
     // Apply ratio to second match (only if best and second are in the same
     // scale level)
     if (bestDist <= mvTH_HIGH[Ftype]) {
@@ -250,6 +257,9 @@ int Associater::SearchByProjection(Frame &F, const vector<MapPoint*> &vpMapPoint
 }
 
 int Associater::SearchByProjection(KeyFrame *pKF, cv::Mat Scw, const vector<MapPoint *> &vpPoints, vector<MapPoint *> &vpMatched, int th, const int Ftype) { 
+  const DescriptorMetric descriptorDistance(pKF->Channels[Ftype].mDescriptors);
+  vector<size_t> vCandidates;
+
   // Get Calibration Parameters for later projection
   const float &fx = pKF->fx;
   const float &fy = pKF->fy;
@@ -327,28 +337,26 @@ int Associater::SearchByProjection(KeyFrame *pKF, cv::Mat Scw, const vector<MapP
     // Match to the most similar keypoint in the radius
     const cv::Mat dMP = pMP->GetDescriptor();
 
-    float bestDist = 3.40282e+38f;
-    int bestIdx = -1;
+    const int *pOctave = pKF->Channels[Ftype].mKeysUnSoA->octave.data();
+    vCandidates.clear();
     for (vector<size_t>::const_iterator vit = vIndices.begin(), vend = vIndices.end(); vit != vend; vit++) {
       const size_t idx = *vit;
       if (vpMatched[idx])
         continue;
 
-      const int &kpLevel = pKF->Channels[Ftype].mvKeysUn[idx].octave;
+      const int kpLevel = pOctave[idx];
 
       if (kpLevel < nPredictedLevel - 1 || kpLevel > nPredictedLevel)
         continue;
 
-      const cv::Mat &dKF = pKF->Channels[Ftype].mDescriptors.row(idx);
-
-      const float dist = DescriptorDistance(dMP, dKF);
-
-      if (dist < bestDist) {
-        bestDist = dist;
-        bestIdx = idx;
-      }
+      vCandidates.push_back(idx);
     }
 
+    const DescriptorMatch match = descriptorDistance.Match(dMP.data, pKF->Channels[Ftype].mDescriptors,
+                                                           vCandidates.data(), vCandidates.size());
+    const float bestDist = match.bestDist;
+    const int bestIdx = match.bestIdx;
+
     if (bestDist <= mvTH_LOW[Ftype]) {
       vpMatched[bestIdx] = pMP;
       nmatches++;
@@ -360,6 +368,9 @@ int Associater::SearchByProjection(KeyFrame *pKF, cv::Mat Scw, const vector<MapP
 
 int Associater::SearchByProjection(Frame &CurrentFrame, KeyFrame *pKF, const set<MapPoint *> &sAlreadyFound, 
                                    const float th, const int ORBdist, const int Ftype) {
+  const DescriptorMetric descriptorDistance(CurrentFrame.Channels[Ftype].mDescriptors);
+  vector<size_t> vCandidates;
+
   int nmatches = 0;
 
   const cv::Mat Rcw = CurrentFrame.mTcw.rowRange(0, 3).colRange(0, 3);
@@ -418,24 +429,20 @@ int Associater::SearchByProjection(Frame &CurrentFrame, KeyFrame *pKF, const set
 
         const cv::Mat dMP = pMP->GetDescriptor();
 
-        float bestDist = 3.40282e+38f;
-        int bestIdx2 = -1;
-
+        vCandidates.clear();
         for (vector<size_t>::const_iterator vit = vIndices2.begin(); vit != vIndices2.end(); vit++) {
           const size_t i2 = *vit;
           if (CurrentFrame.Channels[Ftype].mvpMapPoints[i2])
             continue;
 
-          const cv::Mat &d = CurrentFrame.Channels[Ftype].mDescriptors.row(i2);
-
-          const float dist = DescriptorDistance(dMP, d);
-
-          if (dist < bestDist) {
-            bestDist = dist;
-            bestIdx2 = i2;
-          }
+          vCandidates.push_back(i2);
         }
 
+        const DescriptorMatch match = descriptorDistance.Match(dMP.data, CurrentFrame.Channels[Ftype].mDescriptors,
+                                                               vCandidates.data(), vCandidates.size());
+        const float bestDist = match.bestDist;
+        const int bestIdx2 = match.bestIdx;
+
         if (bestDist <= ORBdist) {
           CurrentFrame.Channels[Ftype].mvpMapPoints[bestIdx2] = pMP;
           nmatches++;
@@ -478,6 +485,9 @@ int Associater::SearchByProjection(Frame &CurrentFrame, KeyFrame *pKF, const set
 
 // used in trackwithkeyframe
 int Associater::SearchByBoW(KeyFrame *pKF, Frame &F, vector<MapPoint *> &vpMapPointMatches, const int Ftype) {
+  const DescriptorMetric descriptorDistance(F.Channels[Ftype].mDescriptors);
+  vector<size_t> vCandidates;
+
   const vector<MapPoint *> vpMapPointsKF = pKF->GetMapPointMatches(Ftype);
 
   vpMapPointMatches = vector<MapPoint *>(F.Channels[Ftype].N, static_cast<MapPoint *>(NULL));
@@ -499,8 +509,8 @@ int Associater::SearchByBoW(KeyFrame *pKF, Frame &F, vector<MapPoint *> &vpMapPo
 
   while (KFit != KFend && Fit != Fend) {
     if (KFit->first == Fit->first) {
-      const vector<unsigned int> vIndicesKF = KFit->second;
-      const vector<unsigned int> vIndicesF = Fit->second;
+      const vector<unsigned int> &vIndicesKF = KFit->second;
+      const vector<unsigned int> &vIndicesF = Fit->second;
 
       for (size_t iKF = 0; iKF < vIndicesKF.size(); iKF++) {
         const unsigned int realIdxKF = vIndicesKF[iKF];
@@ -513,31 +523,24 @@ int Associater::SearchByBoW(KeyFrame *pKF, Frame &F, vector<MapPoint *> &vpMapPo
         if (pMP->isBad())
           continue;
 
-        const cv::Mat &dKF = pKF->Channels[Ftype].mDescriptors.row(realIdxKF);
-
-        float bestDist1 = 3.40282e+38f;
-        int bestIdxF = -1;
-        float bestDist2 = 3.40282e+38f;
+        const uchar *dKF = pKF->Channels[Ftype].mDescriptors.ptr(realIdxKF);
 
+        vCandidates.clear();
         for (size_t iF = 0; iF < vIndicesF.size(); iF++) {
           const unsigned int realIdxF = vIndicesF[iF];
 
           if (vpMapPointMatches[realIdxF])
             continue;
 
-          const cv::Mat &dF = F.Channels[Ftype].mDescriptors.row(realIdxF);
-
-          const float dist = DescriptorDistance(dKF, dF);
-
-          if (dist < bestDist1) {
-            bestDist2 = bestDist1;
-            bestDist1 = dist;
-            bestIdxF = realIdxF;
-          } else if (dist < bestDist2) {
-            bestDist2 = dist;
-          }
+          vCandidates.push_back(realIdxF);
         }
 
+        const DescriptorMatch match = descriptorDistance.Match(dKF, F.Channels[Ftype].mDescriptors,
+                                                               vCandidates.data(), vCandidates.size());
+        const float bestDist1 = match.bestDist;
+        const int bestIdxF = match.bestIdx;
+        const float bestDist2 = match.secondDist;
+
         if (bestDist1 <= mvTH_LOW[Ftype]) {
           if (static_cast<float>(bestDist1) <
               mfNNratio * static_cast<float>(bestDist2)) {
@@ -589,9 +592,107 @@ int Associater::SearchByBoW(KeyFrame *pKF, Frame &F, vector<MapPoint *> &vpMapPo
   return nmatches;
 }
 
+// used in relocalisation, when SearchByBoW finds too few matches
+int Associater::SearchByIndex(KeyFrame *pKF, Frame &F, vector<MapPoint *> &vpMapPointMatches, const int Ftype) {
+  vpMapPointMatches = vector<MapPoint *>(F.Channels[Ftype].N, static_cast<MapPoint *>(NULL));
+
+  const std::shared_ptr<const DescriptorIndex> pIndex = pKF->GetDescriptorIndex(Ftype);
+  if (!pIndex || pIndex->Size() == 0 || F.Channels[Ftype].N == 0)
+    return 0;
+
+  const vector<MapPoint *> vpMapPointsKF = pKF->GetMapPointMatches(Ftype);
+  const cv::Mat &DescriptorsKF = pKF->Channels[Ftype].mDescriptors;
+  const cv::Mat &DescriptorsF = F.Channels[Ftype].mDescriptors;
+  const DescriptorMetric descriptorDistance(DescriptorsKF);
+
+  // Approximate neighbours of every frame keypoint among the keyframe keypoints, rescored exactly
+  cv::Mat nearest;
+  pIndex->Search(DescriptorsF, INDEX_KNN, nearest);
+
+  // A keyframe point keeps the closest frame keypoint matched to it
+  vector<int> vMatchedF(DescriptorsKF.rows, -1);
+  vector<float> vMatchedDist(DescriptorsKF.rows, 0.0f);
+  vector<size_t> vCandidates(INDEX_KNN);
+  for (int idxF = 0; idxF < F.Channels[Ftype].N; idxF++) {
+    const int *pNearest = nearest.ptr<int>(idxF);
+    int nCandidates = 0;
+    for (int k = 0; k < INDEX_KNN; k++)
+      if (pNearest[k] >= 0)
+        vCandidates[nCandidates++] = pNearest[k];
+
+    const DescriptorMatch match = descriptorDistance.Match(DescriptorsF.ptr(idxF), DescriptorsKF,
+                                                           vCandidates.data(), nCandidates);
+    const float bestDist1 = match.bestDist;
+    const int bestIdxKF = match.bestIdx;
+    const float bestDist2 = match.secondDist;
+
+    if (bestIdxKF < 0 || bestDist1 > mvTH_LOW[Ftype])
+      continue;
+    if (static_cast<float>(bestDist1) >= mfNNratio * static_cast<float>(bestDist2))
+      continue;
+
+    MapPoint *pMP = vpMapPointsKF[bestIdxKF];
+    if (!pMP || pMP->isBad())
+      continue;
+
+    if (vMatchedF[bestIdxKF] < 0 || bestDist1 < vMatchedDist[bestIdxKF]) {
+      vMatchedF[bestIdxKF] = idxF;
+      vMatchedDist[bestIdxKF] = bestDist1;
+    }
+  }
+
+  int nmatches = 0;
+
+  vector<int> rotHist[HISTO_LENGTH];
+  for (int i = 0; i < HISTO_LENGTH; i++)
+    rotHist[i].reserve(500);
+  const float factor = 1.0f / HISTO_LENGTH;
+
+  for (size_t idxKF = 0; idxKF < vMatchedF.size(); idxKF++) {
+    const int idxF = vMatchedF[idxKF];
+    if (idxF < 0)
+      continue;
+
+    vpMapPointMatches[idxF] = vpMapPointsKF[idxKF];
+
+    if (mbCheckOrientation) {
+      float rot = pKF->Channels[Ftype].mvKeysUn[idxKF].angle - F.Channels[Ftype].mvKeys[idxF].angle;
+      if (rot < 0.0)
+        rot += 360.0f;
+      int bin = round(rot * factor);
+      if (bin == HISTO_LENGTH)
+        bin = 0;
+      assert(bin >= 0 && bin < HISTO_LENGTH);
+      rotHist[bin].push_back(idxF);
+    }
+    nmatches++;
+  }
+
+  if (mbCheckOrientation) {
+    int ind1 = -1;
+    int ind2 = -1;
+    int ind3 = -1;
+
+    ComputeThreeMaxima(rotHist, HISTO_LENGTH, ind1, ind2, ind3);
+
+    for (int i = 0; i < HISTO_LENGTH; i++) {
+      if (i == ind1 || i == ind2 || i == ind3)
+        continue;
+      for (size_t j = 0, jend = rotHist[i].size(); j < jend; j++) {
+        vpMapPointMatches[rotHist[i][j]] = static_cast<MapPoint *>(NULL);
+        nmatches--;
+      }
+    }
+  }
+
+  return nmatches;
+}
+
 // used in the loopclosing 
 int Associater::SearchByBoW(KeyFrame *pKF1, KeyFrame *pKF2, vector<MapPoint *> &vpMatches12, const int Ftype) {
-  
+  const DescriptorMetric descriptorDistance(pKF1->Channels[Ftype].mDescriptors);
+  vector<size_t> vCandidates;
+
   // step 1 : get key points of two channels
   const vector<cv::KeyPoint> &vKeysUn1 = pKF1->Channels[Ftype].mvKeysUn;
   const fbow::fBow2 &vFeatVec1 = pKF1->Channels[Ftype].mFeatVec;
@@ -630,12 +731,9 @@ int Associater::SearchByBoW(KeyFrame *pKF1, KeyFrame *pKF2, vector<MapPoint *> &
         if (pMP1->isBad())
           continue;
 
-        const cv::Mat &d1 = Descriptors1.row(idx1);
-
-        float bestDist1 = 3.40282e+38f;
-        int bestIdx2 = -1;
-        float bestDist2 = 3.40282e+38f;
+        const uchar *d1 = Descriptors1.ptr(idx1);
 
+        vCandidates.clear();
         for (size_t i2 = 0, iend2 = f2it->second.size(); i2 < iend2; i2++) {
           const size_t idx2 = f2it->second[i2];
 
@@ -647,19 +745,14 @@ int Associater::SearchByBoW(KeyFrame *pKF1, KeyFrame *pKF2, vector<MapPoint *> &
           if (pMP2->isBad())
             continue;
 
-          const cv::Mat &d2 = Descriptors2.row(idx2);
-
-          float dist = DescriptorDistance(d1, d2);
-
-          if (dist < bestDist1) {
-            bestDist2 = bestDist1;
-            bestDist1 = dist;
-            bestIdx2 = idx2;
-          } else if (dist < bestDist2) {
-            bestDist2 = dist;
-          }
+          vCandidates.push_back(idx2);
         }
 
+        const DescriptorMatch match = descriptorDistance.Match(d1, Descriptors2, vCandidates.data(), vCandidates.size());
+        const float bestDist1 = match.bestDist;
+        const int bestIdx2 = match.bestIdx;
+        const float bestDist2 = match.secondDist;
+
         if (bestDist1 < mvTH_LOW[Ftype]) {
           if (static_cast<float>(bestDist1) <mfNNratio * static_cast<float>(bestDist2)) {
             vpMatches12[idx1] = vpMapPoints2[bestIdx2];
@@ -709,89 +802,241 @@ int Associater::SearchByBoW(KeyFrame *pKF1, KeyFrame *pKF2, vector<MapPoint *> &
   return nmatches;
 }
 
+namespace {
+
+// Pixel position of a map point in a frame with pose Tcw, false when behind the camera or out of the image
+bool ProjectToFrame(const Frame &F, const cv::Mat &Rcw, const cv::Mat &tcw, MapPoint *pMP, cv::Point2f &uv) {
+  const cv::Mat x3Dc = Rcw * pMP->GetWorldPos() + tcw;
+  const float zc = x3Dc.at<float>(2);
+  if (zc <= 0.0f)
+    return false;
+
+  const float invzc = 1.0f / zc;
+  uv.x = F.fx * x3Dc.at<float>(0) * invzc + F.cx;
+  uv.y = F.fy * x3Dc.at<float>(1) * invzc + F.cy;
+  return uv.x >= F.mnMinX && uv.x <= F.mnMaxX && uv.y >= F.mnMinY && uv.y <= F.mnMaxY;
+}
+
+} // namespace
+
+void Associater::SearchMutualNN(const cv::Mat &Q, const vector<int> &vQueryRows, const vector<cv::Point2f> &vPrior,
+                                const vector<float> &vRadius, const Frame &F, const int Ftype, vector<int> &vMatches,
+                                vector<float> &vDists, const DescriptorIndex *pQueryIndex) {
+  const int nQuery = vQueryRows.size();
+  const int nTrain = F.Channels[Ftype].N;
+  vMatches.assign(nQuery, -1);
+  vDists.assign(nQuery, FLT_MAX);
+  if (nQuery == 0 || nTrain == 0)
+    return;
+
+  const cv::Mat &D = F.Channels[Ftype].mDescriptors;
+  const DescriptorMetric descriptorDistance(D);
+
+  // Forward: nearest keypoint of every searched row
+  vector<int> vForward(nQuery, -1);
+  vector<float> vForwardDist(nQuery, FLT_MAX);
+  if (!vPrior.empty() || (size_t)nQuery * nTrain <= NN_EXHAUSTIVE_PAIRS) {
+    // Without a prior every keypoint is a candidate
+    vector<size_t> vIndices;
+    if (vPrior.empty()) {
+      vIndices.resize(nTrain);
+      for (int t = 0; t < nTrain; t++)
+        vIndices[t] = t;
+    }
+
+    for (int q = 0; q < nQuery; q++) {
+      if (!vPrior.empty())
+        vIndices = F.GetFeaturesInArea(Ftype, vPrior[q].x, vPrior[q].y, vRadius[q]);
+
+      const DescriptorMatch match = descriptorDistance.Match(Q.ptr(vQueryRows[q]), D, vIndices.data(), vIndices.size());
+      vForward[q] = match.bestIdx;
+      vForwardDist[q] = match.bestDist;
+    }
+  } else {
+    // No prior and too many pairs: approximate nearest keypoints. The index distances are squared
+    // for L2, rescore the hits exactly
+    cv::Mat Qs(nQuery, Q.cols, Q.type());
+    for (int q = 0; q < nQuery; q++)
+      Q.row(vQueryRows[q]).copyTo(Qs.row(q));
+
+    cv::Mat indices;
+    DescriptorIndex(D).Search(Qs, 1, indices);
+    for (int q = 0; q < nQuery; q++) {
+      const int t = indices.at<int>(q, 0);
+      if (t < 0)
+        continue;
+      vForward[q] = t;
+      vForwardDist[q] = descriptorDistance(Qs.ptr(q), D.ptr(t));
+    }
+  }
+
+  // A keypoint hit by several searched rows keeps the nearest one as its candidate
+  vector<int> vCandidate(nTrain, -1);
+  for (int q = 0; q < nQuery; q++) {
+    const int t = vForward[q];
+    if (t >= 0 && (vCandidate[t] < 0 || vForwardDist[q] < vForwardDist[vCandidate[t]]))
+      vCandidate[t] = q;
+  }
+
+  vector<int> vHit;
+  for (int t = 0; t < nTrain; t++)
+    if (vCandidate[t] >= 0)
+      vHit.push_back(t);
+  const int nHit = vHit.size();
+
+  // Backward: nearest row of every hit keypoint among ALL rows of Q, searched or not, so that a
+  // keypoint nearer to a row without a map point (or out of the prior windows) is not matched
+  vector<int> vBackward(nHit, -1);
+  vector<float> vBackwardDist(nHit, FLT_MAX);
+  if ((size_t)Q.rows * nHit <= NN_EXHAUSTIVE_PAIRS) {
+    vector<size_t> vRows(Q.rows);
+    for (int r = 0; r < Q.rows; r++)
+      vRows[r] = r;
+
+    for (int k = 0; k < nHit; k++) {
+      const DescriptorMatch match = descriptorDistance.Match(D.ptr(vHit[k]), Q, vRows.data(), Q.rows);
+      vBackward[k] = match.bestIdx;
+      vBackwardDist[k] = match.bestDist;
+    }
+  } else {
+    cv::Mat Ds(nHit, D.cols, D.type());
+    for (int k = 0; k < nHit; k++)
+      D.row(vHit[k]).copyTo(Ds.row(k));
+
+    cv::Mat indices;
+    if (pQueryIndex)
+      pQueryIndex->Search(Ds, 1, indices);
+    else
+      DescriptorIndex(Q).Search(Ds, 1, indices);
+    for (int k = 0; k < nHit; k++) {
+      const int r = indices.at<int>(k, 0);
+      if (r < 0)
+        continue;
+      vBackward[k] = r;
+      vBackwardDist[k] = descriptorDistance(Ds.ptr(k), Q.ptr(r));
+    }
+  }
+
+  // Mutual when the nearest row is the candidate itself, or farther than it (a row the approximate
+  // search missed: the candidate is then the nearest one found)
+  for (int k = 0; k < nHit; k++) {
+    const int t = vHit[k];
+    const int q = vCandidate[t];
+    if (vBackward[k] == vQueryRows[q] || vForwardDist[q] < vBackwardDist[k]) {
+      vMatches[q] = t;
+      vDists[q] = vForwardDist[q];
+    }
+  }
+}
+
 // search by nearest nerghbour
 int Associater::SearchByNN(Frame &CurrentFrame, const Frame &LastFrame, const int Ftype) {
-  
-  std::vector<cv::DMatch> matches;
-  // cv::BFMatcher desc_matcher(cv::NORM_HAMMING, true);
-  cv::BFMatcher desc_matcher((LastFrame.Channels[Ftype].mDescriptors.depth() == CV_8U) ?
-                              cv::NORM_HAMMING : cv::NORM_L2, true);
-  desc_matcher.match(LastFrame.Channels[Ftype].mDescriptors, CurrentFrame.Channels[Ftype].mDescriptors, matches, cv::Mat());
-
-  int nmatches = 0;
-  for (int i = 0; i < static_cast<int>(matches.size()); ++i) {
-    int realIdxKF = matches[i].queryIdx;
-    int bestIdxF = matches[i].trainIdx;
+  // Last frame keypoints with a map point, searched around their projection when the current pose is predicted
+  const bool bPrior = !CurrentFrame.mTcw.empty();
+  cv::Mat Rcw, tcw;
+  if (bPrior) {
+    Rcw = CurrentFrame.mTcw.rowRange(0, 3).colRange(0, 3);
+    tcw = CurrentFrame.mTcw.rowRange(0, 3).col(3);
+  }
 
-    if (matches[i].distance > mvTH_LOW[Ftype])
-      continue;
-    
-    MapPoint *pMP = LastFrame.Channels[Ftype].mvpMapPoints[realIdxKF];
-    if (!pMP)
+  vector<cv::Point2f> vPrior;
+  vector<float> vRadius;
+  vector<int> vQueryIdx;
+  for (int i = 0; i < LastFrame.Channels[Ftype].N; i++) {
+    MapPoint *pMP = LastFrame.Channels[Ftype].mvpMapPoints[i];
+    if (!pMP || pMP->isBad())
       continue;
 
-    if (pMP->isBad())
+    if (bPrior) {
+      cv::Point2f uv;
+      if (!ProjectToFrame(CurrentFrame, Rcw, tcw, pMP, uv))
+        continue;
+      vPrior.push_back(uv);
+      vRadius.push_back(NN_RADIUS * CurrentFrame.mvScaleFactors[LastFrame.Channels[Ftype].mvKeysUn[i].octave]);
+    }
+    vQueryIdx.push_back(i);
+  }
+
+  // Every last frame keypoint takes part in the mutual check
+  vector<int> vMatches;
+  vector<float> vDists;
+  SearchMutualNN(LastFrame.Channels[Ftype].mDescriptors, vQueryIdx, vPrior, vRadius, CurrentFrame, Ftype, vMatches,
+                 vDists);
+
+  int nmatches = 0;
+  for (size_t q = 0; q < vMatches.size(); q++) {
+    const int bestIdxF = vMatches[q];
+    if (bestIdxF < 0 || vDists[q] > mvTH_LOW[Ftype])
       continue;
 
+    const int realIdxKF = vQueryIdx[q];
     if (!LastFrame.Channels[Ftype].mvbOutlier[realIdxKF])
-      CurrentFrame.Channels[Ftype].mvpMapPoints[bestIdxF] = pMP;
+      CurrentFrame.Channels[Ftype].mvpMapPoints[bestIdxF] = LastFrame.Channels[Ftype].mvpMapPoints[realIdxKF];
 
     nmatches++;
-
   }
-  
+
   return nmatches;
 }
 
 // vpMapPointMatches should be the mappoints of frame, we want to match the points on frame to the keyframe
 int Associater::SearchByNN(KeyFrame *pKF, Frame &F, std::vector<MapPoint *> &vpMapPointMatches, const int FType) {
-
-  // std::cout << "Matching KeyFrame" << std::endl;
-  // std::cout << pKF->mDescriptors.rows << std::endl;
-  // std::cout << F.mDescriptors.rows << std::endl;
-
   const vector<MapPoint *> vpMapPointsKF = pKF->GetMapPointMatches(FType);
   vpMapPointMatches = vector<MapPoint *>(F.Channels[FType].N, static_cast<MapPoint *>(NULL));
 
-  std::vector<cv::DMatch> matches;
-  // cv::BFMatcher desc_matcher(cv::NORM_HAMMING, true);
-  cv::BFMatcher desc_matcher((F.Channels[FType].mDescriptors.depth() == CV_8U) ?
-                              cv::NORM_HAMMING : cv::NORM_L2, true);
-  desc_matcher.match(pKF->Channels[FType].mDescriptors, F.Channels[FType].mDescriptors, matches, cv::Mat());
-
-  int nmatches = 0;
-  for (int i = 0; i < static_cast<int>(matches.size()); ++i) {
-    int realIdxKF = matches[i].queryIdx;
-    int bestIdxF = matches[i].trainIdx;
+  // Keyframe keypoints with a map point, searched around their projection when the frame pose is predicted
+  const bool bPrior = !F.mTcw.empty();
+  cv::Mat Rcw, tcw;
+  if (bPrior) {
+    Rcw = F.mTcw.rowRange(0, 3).colRange(0, 3);
+    tcw = F.mTcw.rowRange(0, 3).col(3);
+  }
 
-    if (matches[i].distance > mvTH_HIGH[FType])
+  vector<cv::Point2f> vPrior;
+  vector<float> vRadius;
+  vector<int> vQueryIdx;
+  for (size_t i = 0; i < vpMapPointsKF.size(); i++) {
+    MapPoint *pMP = vpMapPointsKF[i];
+    if (!pMP || pMP->isBad())
       continue;
 
-    MapPoint *pMP = vpMapPointsKF[realIdxKF];
+    if (bPrior) {
+      cv::Point2f uv;
+      if (!ProjectToFrame(F, Rcw, tcw, pMP, uv))
+        continue;
+      vPrior.push_back(uv);
+      vRadius.push_back(NN_RADIUS * F.mvScaleFactors[pKF->Channels[FType].mvKeysUn[i].octave]);
+    }
+    vQueryIdx.push_back(i);
+  }
 
-    if (!pMP)
-      continue;
+  // Every keyframe keypoint takes part in the mutual check. Its descriptors are indexed once
+  // (LocalMapping), only the frame side is built here
+  const std::shared_ptr<const DescriptorIndex> pKFIndex = pKF->GetDescriptorIndex(FType);
+  vector<int> vMatches;
+  vector<float> vDists;
+  SearchMutualNN(pKF->Channels[FType].mDescriptors, vQueryIdx, vPrior, vRadius, F, FType, vMatches, vDists,
+                 pKFIndex.get());
 
-    if (pMP->isBad())
+  int nmatches = 0;
+  for (size_t q = 0; q < vMatches.size(); q++) {
+    const int bestIdxF = vMatches[q];
+    if (bestIdxF < 0 || vDists[q] > mvTH_HIGH[FType])
       continue;
 
-    vpMapPointMatches[bestIdxF] = pMP;
+    vpMapPointMatches[bestIdxF] = vpMapPointsKF[vQueryIdx[q]];
     nmatches++;
   }
-  // std::cout << nmatches << std::endl;
 
   return nmatches;
 }
 
 int Associater::SearchByNN(Frame &F, const vector<MapPoint *> &vpMapPoints) {
-  // std::cout << "Matching Localmap" << std::endl;
-  // std::cout << vpMapPoints.size() << std::endl;
-  // std::cout << F.Channels[0].mDescriptors.rows << std::endl;
-
-  vector<vector<cv::Mat>> MPdescriptorAll;
-  vector<vector<int>> select_indice;
-  MPdescriptorAll.resize(F.Ntype);
-  select_indice.resize(F.Ntype);
+  // Map points in view of the frame (isInFrustum), searched around their predicted projection
+  vector<vector<cv::Mat>> MPdescriptorAll(F.Ntype);
+  vector<vector<cv::Point2f>> vPrior(F.Ntype);
+  vector<vector<float>> vRadius(F.Ntype);
+  vector<vector<int>> select_indice(F.Ntype);
   for (size_t iMP = 0; iMP < vpMapPoints.size(); iMP++) {
     MapPoint *pMP = vpMapPoints[iMP];
 
@@ -808,77 +1053,51 @@ int Associater::SearchByNN(Frame &F, const vector<MapPoint *> &vpMapPoints) {
     if (Ftype == -1)
       continue;
 
-    const cv::Mat MPdescriptor = pMP->GetDescriptor();
-    MPdescriptorAll[Ftype].push_back(MPdescriptor);
+    MPdescriptorAll[Ftype].push_back(pMP->GetDescriptor());
+    vPrior[Ftype].push_back(cv::Point2f(pMP->mTrackProjX, pMP->mTrackProjY));
+    vRadius[Ftype].push_back(NN_RADIUS * F.mvScaleFactors[pMP->mnTrackScaleLevel]);
     select_indice[Ftype].push_back(iMP);
   }
 
-  vector<cv::Mat> MPdescriptors;
-  MPdescriptors.resize(F.Ntype);
-
-  /*
-  for (int Ftype = 0; Ftype < F.Ntype; Ftype++) {
-    MPdescriptors[Ftype].create(MPdescriptorAll[Ftype].size(), MPdescriptorAll[Ftype][0].cols, MPdescriptorAll[Ftype][0].type());
-  }
-  
+  int nmatches = 0;
+  vector<int> vMatches;
+  vector<float> vDists;
   for (int Ftype = 0; Ftype < F.Ntype; Ftype++) {
-    for (int i = 0; i < static_cast<int>(MPdescriptorAll[Ftype].size()); i++) {
-      for (int j = 0; j < MPdescriptorAll[Ftype][0].cols; j++) {
-        MPdescriptors[Ftype].at<unsigned char>(i, j) = MPdescriptorAll[Ftype][i].at<unsigned char>(j);
-      }
-    }
-  }
-  */
-
-  for (int f = 0; f < F.Ntype; ++f) {
-    if (MPdescriptorAll[f].empty()) continue;
-
-    const int dim    = MPdescriptorAll[f][0].cols;   // 32, 64, 128…
-    const int cvType = MPdescriptorAll[f][0].type(); // CV_8U or CV_32F
+    const int nQuery = MPdescriptorAll[Ftype].size();
+    if (nQuery == 0)
+      continue;
 
-    MPdescriptors[f].create(MPdescriptorAll[f].size(), dim, cvType);
+    cv::Mat MPdescriptors(nQuery, MPdescriptorAll[Ftype][0].cols, MPdescriptorAll[Ftype][0].type());
+    vector<int> vQueryRows(nQuery);
+    for (int q = 0; q < nQuery; q++) {
+      MPdescriptorAll[Ftype][q].copyTo(MPdescriptors.row(q));
+      vQueryRows[q] = q;
+    }
 
-    for (size_t i = 0; i < MPdescriptorAll[f].size(); ++i)
-        MPdescriptorAll[f][i].copyTo(MPdescriptors[f].row((int)i));
-  }
+    SearchMutualNN(MPdescriptors, vQueryRows, vPrior[Ftype], vRadius[Ftype], F, Ftype, vMatches, vDists);
 
-  vector<vector<cv::DMatch>> matches;
-  matches.resize(F.Ntype);
-  // cv::BFMatcher desc_matcher(cv::NORM_HAMMING, true);
-  for (int Ftype = 0; Ftype < F.Ntype; Ftype++) {
-    cv::BFMatcher desc_matcher((MPdescriptors[Ftype].depth() == CV_8U) ?
-                                cv::NORM_HAMMING : cv::NORM_L2, true);
-    desc_matcher.match(MPdescriptors[Ftype], F.Channels[Ftype].mDescriptors, matches[Ftype], cv::Mat());
-  }
-  
-  int nmatches = 0;
-  for (int Ftype = 0; Ftype < F.Ntype; Ftype++) {
-    for (int i = 0; i < static_cast<int>(matches[Ftype].size()); ++i) {
-      int realIdxMap = select_indice[Ftype][matches[Ftype][i].queryIdx];
-      int bestIdxF = matches[Ftype][i].trainIdx;
-
-      if (matches[Ftype][i].distance > mvTH_HIGH[Ftype])
+    for (int q = 0; q < nQuery; q++) {
+      const int bestIdxF = vMatches[q];
+      if (bestIdxF < 0 || vDists[q] > mvTH_HIGH[Ftype])
         continue;
 
       if (F.Channels[Ftype].mvpMapPoints[bestIdxF])
         if (F.Channels[Ftype].mvpMapPoints[bestIdxF]->Observations() > 0)
           continue;
 
-      MapPoint *pMP = vpMapPoints[realIdxMap];
-      F.Channels[Ftype].mvpMapPoints[bestIdxF] = pMP;
-
+      F.Channels[Ftype].mvpMapPoints[bestIdxF] = vpMapPoints[select_indice[Ftype][q]];
       nmatches++;
     }
   }
-  
-  // std::cout << MPdescriptors[0].rows << std::endl;
-  // std::cout << nmatches << std::endl;
 
   return nmatches;
 }
 
 int Associater::SearchForTriangulation(KeyFrame *pKF1, KeyFrame *pKF2, cv::Mat F12, std::vector<std::pair<size_t, size_t>> &vMatchedPairs, 
                                        const bool bOnlyStereo, const int Ftype) {
+  const DescriptorMetric descriptorDistance(pKF1->Channels[Ftype].mDescriptors);
+  vector<size_t> vCandidates;
+  vector<float> vDists;
 
   const fbow::fBow2 &vFeatVec1 = pKF1->Channels[Ftype].mFeatVec;
   const fbow::fBow2 &vFeatVec2 = pKF2->Channels[Ftype].mFeatVec;
@@ -928,11 +1147,9 @@ int Associater::SearchForTriangulation(KeyFrame *pKF1, KeyFrame *pKF2, cv::Mat F
 
         const cv::KeyPoint &kp1 = pKF1->Channels[Ftype].mvKeysUn[idx1];
 
-        const cv::Mat &d1 = pKF1->Channels[Ftype].mDescriptors.row(idx1);
-
-        float bestDist = mvTH_LOW[Ftype];
-        int bestIdx2 = -1;
+        const uchar *d1 = pKF1->Channels[Ftype].mDescriptors.ptr(idx1);
 
+        vCandidates.clear();
         for (size_t i2 = 0, iend2 = f2it->second.size(); i2 < iend2; i2++) {
           size_t idx2 = f2it->second[i2];
 
@@ -948,9 +1165,21 @@ int Associater::SearchForTriangulation(KeyFrame *pKF1, KeyFrame *pKF2, cv::Mat F
             if (!bStereo2)
               continue;
 
-          const cv::Mat &d2 = pKF2->Channels[Ftype].mDescriptors.row(idx2);
+          vCandidates.push_back(idx2);
+        }
+
+        // All descriptor distances of the node at once, then the geometric checks in candidate order
+        const int nCandidates = vCandidates.size();
+        vDists.resize(nCandidates);
+        descriptorDistance.Batch(d1, pKF2->Channels[Ftype].mDescriptors, vCandidates.data(), nCandidates, vDists.data());
+
+        float bestDist = mvTH_LOW[Ftype];
+        int bestIdx2 = -1;
 
-          const float dist = DescriptorDistance(d1, d2);
+        for (int iC = 0; iC < nCandidates; iC++) {
+          const size_t idx2 = vCandidates[iC];
+          const bool bStereo2 = pKF2->Channels[Ftype].mvuRight[idx2] >= 0;
+          const float dist = vDists[iC];
 
           if (dist > mvTH_LOW[Ftype] || dist > bestDist)
             continue;
@@ -1028,6 +1257,10 @@ int Associater::SearchForTriangulation(KeyFrame *pKF1, KeyFrame *pKF2, cv::Mat F
 
 int Associater::SearchBySim3(KeyFrame *pKF1, KeyFrame *pKF2, vector<MapPoint *> &vpMatches12, const float &s12,
                              const cv::Mat &R12, const cv::Mat &t12, const float th, const int Ftype) {
+  // Descriptor metric of the channel (either keyframe may have no keypoints in it)
+  const DescriptorMetric descriptorDistance(pKF1->Channels[Ftype].mDescriptors.empty() ? pKF2->Channels[Ftype].mDescriptors
+                                                                                  : pKF1->Channels[Ftype].mDescriptors);
+
   const float &fx = pKF1->fx;
   const float &fy = pKF1->fy;
   const float &cx = pKF1->cx;
@@ -1131,7 +1364,7 @@ int Associater::SearchBySim3(KeyFrame *pKF1, KeyFrame *pKF2, vector<MapPoint *>
 
       const cv::Mat &dKF = pKF2->Channels[Ftype].mDescriptors.row(idx);
 
-      const float dist = DescriptorDistance(dMP, dKF);
+      const float dist = descriptorDistance(dMP, dKF);
 
       if (dist < bestDist) {
         bestDist = dist;
@@ -1207,7 +1440,7 @@ int Associater::SearchBySim3(KeyFrame *pKF1, KeyFrame *pKF2, vector<MapPoint *>
 
       const cv::Mat &dKF = pKF1->Channels[Ftype].mDescriptors.row(idx);
 
-      const float dist = DescriptorDistance(dMP, dKF);
+      const float dist = descriptorDistance(dMP, dKF);
 
       if (dist < bestDist) {
         bestDist = dist;
@@ -1239,6 +1472,8 @@ int Associater::SearchBySim3(KeyFrame *pKF1, KeyFrame *pKF2, vector<MapPoint *>
 }
 
 int Associater::SearchForInitialization(const int Ftype, Frame &F1, Frame &F2, vector<cv::Point2f> &vbPrevMatched, vector<int> &vnMatches12, int windowSize) {
+  const DescriptorMetric descriptorDistance(F1.Channels[Ftype].mDescriptors);
+
   int nmatches = 0;
   vnMatches12 = vector<int>(F1.Channels[Ftype].mvKeysUn.size(), -1);
 
@@ -1272,7 +1507,7 @@ int Associater::SearchForInitialization(const int Ftype, Frame &F1, Frame &F2, v
 
       cv::Mat d2 = F2.Channels[Ftype].mDescriptors.row(i2);
 
-      float dist = DescriptorDistance(d1, d2);
+      float dist = descriptorDistance(d1, d2);
 
       if (vMatchedDistance[i2] <= dist)
         continue;
@@ -1340,6 +1575,9 @@ int Associater::SearchForInitialization(const int Ftype, Frame &F1, Frame &F2, v
 }
 
 int Associater::Fuse(const int Ftype, KeyFrame *pKF, const vector<MapPoint *> &vpMapPoints, const float th) {
+  const DescriptorMetric descriptorDistance(pKF->Channels[Ftype].mDescriptors);
+  vector<size_t> vCandidates;
+
   cv::Mat Rcw = pKF->GetRotation();
   cv::Mat tcw = pKF->GetTranslation();
 
@@ -1413,8 +1651,7 @@ int Associater::Fuse(const int Ftype, KeyFrame *pKF, const vector<MapPoint *> &v
 
     const cv::Mat dMP = pMP->GetDescriptor();
 
-    float bestDist = 3.40282e+38f;
-    int bestIdx = -1;
+    vCandidates.clear();
     for (vector<size_t>::const_iterator vit = vIndices.begin(), vend = vIndices.end(); vit != vend; vit++) {
       const size_t idx = *vit;
 
@@ -1448,16 +1685,14 @@ int Associater::Fuse(const int Ftype, KeyFrame *pKF, const vector<MapPoint *> &v
           continue;
       }
 
-      const cv::Mat &dKF = pKF->Channels[Ftype].mDescriptors.row(idx);
-
-      const float dist = DescriptorDistance(dMP, dKF);
-
-      if (dist < bestDist) {
-        bestDist = dist;
-        bestIdx = idx;
-      }
+      vCandidates.push_back(idx);
     }
 
+    const DescriptorMatch match = descriptorDistance.Match(dMP.data, pKF->Channels[Ftype].mDescriptors,
+                                                           vCandidates.data(), vCandidates.size());
+    const float bestDist = match.bestDist;
+    const int bestIdx = match.bestIdx;
+
     // If there is already a MapPoint replace otherwise add new measurement
     if (bestDist <= mvTH_LOW[Ftype]) {
       MapPoint *pMPinKF = pKF->GetMapPoint(bestIdx, Ftype);
@@ -1480,6 +1715,9 @@ int Associater::Fuse(const int Ftype, KeyFrame *pKF, const vector<MapPoint *> &v
 }
 
 int Associater::Fuse(const int Ftype, KeyFrame *pKF, cv::Mat Scw, const vector<MapPoint *> &vpPoints, float th, vector<MapPoint *> &vpReplacePoint) {
+  const DescriptorMetric descriptorDistance(pKF->Channels[Ftype].mDescriptors);
+  vector<size_t> vCandidates;
+
   // Get Calibration Parameters for later projection
   const float &fx = pKF->fx;
   const float &fy = pKF->fy;
@@ -1560,25 +1798,23 @@ int Associater::Fuse(const int Ftype, KeyFrame *pKF, cv::Mat Scw, const vector<M
 
     const cv::Mat dMP = pMP->GetDescriptor();
 
-    float bestDist = 3.40282e+38f;
-    int bestIdx = -1;
+    const int *pOctave = pKF->Channels[Ftype].mKeysUnSoA->octave.data();
+    vCandidates.clear();
     for (vector<size_t>::const_iterator vit = vIndices.begin(); vit != vIndices.end(); vit++) {
       const size_t idx = *vit;
-      const int &kpLevel = pKF->Channels[Ftype].mvKeysUn[idx].octave;
+      const int kpLevel = pOctave[idx];
 
       if (kpLevel < nPredictedLevel - 1 || kpLevel > nPredictedLevel)
         continue;
 
-      const cv::Mat &dKF = pKF->Channels[Ftype].mDescriptors.row(idx);
-
-      float dist = DescriptorDistance(dMP, dKF);
-
-      if (dist < bestDist) {
-        bestDist = dist;
-        bestIdx = idx;
-      }
+      vCandidates.push_back(idx);
     }
 
+    const DescriptorMatch match = descriptorDistance.Match(dMP.data, pKF->Channels[Ftype].mDescriptors,
+                                                           vCandidates.data(), vCandidates.size());
+    const float bestDist = match.bestDist;
+    const int bestIdx = match.bestIdx;
+
     // If there is already a MapPoint replace otherwise add new measurement
     if (bestDist <= mvTH_LOW[Ftype]) {
       MapPoint *pMPinKF = pKF->GetMapPoint(bestIdx, Ftype);
@@ -1633,23 +1869,7 @@ void Associater::ComputeThreeMaxima(vector<int> *histo, const int L, int &ind1,
 
 
 float Associater::DescriptorDistance(const cv::Mat &a, const cv::Mat &b) {
-  if (a.depth() == CV_8U) {
-	const uchar* pa = a.ptr<uchar>();
-  	const uchar* pb = b.ptr<uchar>();
-  	int dist = 0;
-  	for (int i = 0; i < a.cols; ++i, ++pa, ++pb)
-      dist += __builtin_popcount(*pa ^ *pb);
-    //std::cout << static_cast<float>(dist) << std::endl;
-  	return static_cast<float>(dist);
-  } else {
-	const float* pa = a.ptr<float>();
-    const float* pb = b.ptr<float>();
-    float dist = 0.f;
-    for (int i = 0; i < a.cols; ++i)
-        dist += (pa[i] - pb[i]) * (pa[i] - pb[i]);
-    //std::cout << std::sqrt(dist) << std::endl;
-    return std::sqrt(dist);
-  }
+  return DescriptorMetric::Distance(a, b);
 }
 
 /*
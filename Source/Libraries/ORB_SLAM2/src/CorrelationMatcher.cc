@@ -1,8 +1,11 @@
 // CorrelationMatcher.cc
 #include "CorrelationMatcher.h"
 #include "CorrelationEdge.h"
+#include "Associater.h"
+#include "DescriptorMetric.h"
 #include <fstream>
-#include <opencv2/flann.hpp>
+#include <algorithm>
+#include <cmath>
 #include <map>
 #include <iomanip>
 
@@ -149,17 +152,15 @@ void CorrelationMatcher::Finalize() {
     }
 }
 
-float CorrelationMatcher::BuildEdges(Frame& F, int chA, int chB, float th_px, size_t th_str)
+void CorrelationMatcher::BuildEdges(Frame& F, float th_px, size_t th_str)
 {
     const int N = F.Ntype;
-    // Check input validity
-    if(chA<0 || chA>=N || chB<0 || chB>=N || chA==chB) return 0;
+    if(N<2 || th_px<=0) return;
 
-    using Node = std::pair<cv::Point2f, MapPoint*>;
-    std::vector<Node> vSrc, vDst;
-
-    /* ---------- 1) Collect the matched points ---------- */
-    auto collect = [&](int ch, std::vector<Node>& v){
+    /* ---------- 1) Collect the matched points of all channels ---------- */
+    std::vector<size_t> vnPoints(N, 0);
+    mvPoints.clear();
+    for(int ch=0; ch<N; ++ch){
         const auto& C = F.Channels[ch];
         for(int i=0;i<C.N;++i){
             MapPoint* p = C.mvpMapPoints[i];
@@ -170,105 +171,163 @@ float CorrelationMatcher::BuildEdges(Frame& F, int chA, int chB, float th_px, si
             if(C.mvbOutlier[i])       continue;          // Judged as outlier
             if(p->Observations() < 1)  continue;         // Temporary VO point
 
-            v.emplace_back(C.mvKeysUn[i].pt, p);         // (pixel coordinates, MapPoint*)
+            const cv::Point2f& pt = C.mvKeysUn[i].pt;
+            mvPoints.push_back(GridPoint{pt.x, pt.y, ch, p});
+            ++vnPoints[ch];
         }
-    };
-    collect(chA, vSrc);
-    collect(chB, vDst);
-
-    // std::cout << "Channel " << chA << " valid points: " << vSrc.size() << std::endl;
-    // std::cout << "Channel " << chB << " valid points: " << vDst.size() << std::endl;
+    }
+    if(mvPoints.empty()) return;                        // No available points
+
+    // ---------- 2) Bucket the points in a uniform grid of th_px cells (counting sort) ---------- //
+    // Points outside the image bounds are clamped into the border cells, which only merges cells:
+    // two points within th_px still fall in the same or adjacent cells
+    const float minX = Frame::mnMinX, minY = Frame::mnMinY;
+    const int nCols = std::max(1, (int)std::ceil((Frame::mnMaxX - minX) / th_px));
+    const int nRows = std::max(1, (int)std::ceil((Frame::mnMaxY - minY) / th_px));
+    const float invCell = 1.0f / th_px;
+
+    const size_t nPoints = mvPoints.size();
+    mvCell.resize(nPoints);
+    mvCellStart.assign((size_t)nCols * nRows + 1, 0);
+    for(size_t k=0; k<nPoints; ++k){
+        const int cx = std::min(std::max((int)std::floor((mvPoints[k].x - minX) * invCell), 0), nCols - 1);
+        const int cy = std::min(std::max((int)std::floor((mvPoints[k].y - minY) * invCell), 0), nRows - 1);
+        mvCell[k] = cy * nCols + cx;
+        ++mvCellStart[mvCell[k] + 1];
+    }
+    for(size_t c=1; c<mvCellStart.size(); ++c)
+        mvCellStart[c] += mvCellStart[c - 1];
+
+    mvSorted.resize(nPoints);
+    mvNext.assign(mvCellStart.begin(), mvCellStart.end() - 1);
+    for(size_t k=0; k<nPoints; ++k)
+        mvSorted[mvNext[mvCell[k]]++] = mvPoints[k];
+
+    // ---------- 3) One sweep over the neighbouring cells, accumulate edges ---------- //
+    // Each unordered pair is visited once, from the point of the lower channel
+    std::vector<size_t> vnCorr((size_t)N * N, 0);
+    const float th2 = th_px * th_px;
+
+    for(int cy=0; cy<nRows; ++cy){
+        const int y0 = std::max(cy - 1, 0), y1 = std::min(cy + 1, nRows - 1);
+        for(int cx=0; cx<nCols; ++cx){
+            const int cell = cy * nCols + cx;
+            if(mvCellStart[cell] == mvCellStart[cell + 1]) continue;
+            const int x0 = std::max(cx - 1, 0), x1 = std::min(cx + 1, nCols - 1);
+
+            for(int a=mvCellStart[cell]; a<mvCellStart[cell + 1]; ++a){
+                const GridPoint& ns = mvSorted[a];
+                for(int ny=y0; ny<=y1; ++ny){
+                    for(int nx=x0; nx<=x1; ++nx){
+                        const int nc = ny * nCols + nx;
+                        for(int b=mvCellStart[nc]; b<mvCellStart[nc + 1]; ++b){
+                            const GridPoint& nd = mvSorted[b];
+                            if(nd.ch <= ns.ch) continue;
+                            if(ns.pMP == nd.pMP) continue;
+
+                            const float dx = ns.x - nd.x;
+                            const float dy = ns.y - nd.y;
+                            if(dx*dx + dy*dy > th2) continue;
+
+                            size_t cnt = ns.pMP->AddEdge(nd.pMP);
+                            if(cnt >= th_str)
+                                ++vnCorr[(size_t)ns.ch * N + nd.ch];
+                        }
+                    }
+                }
+            }
+        }
+    }
 
-    if(vSrc.empty() || vDst.empty()) return 0;      // No available points
+    // Save correlation status of every channel pair for evaluation and logging
+    for(int chA=0; chA<N; ++chA){
+        for(int chB=chA+1; chB<N; ++chB){
+            const size_t nA = vnPoints[chA];
+            const size_t nB = vnPoints[chB];
+            if(nA == 0 || nB == 0) continue;            // No available points
+
+            const size_t nCorr = vnCorr[(size_t)chA * N + chB];
+            float fnA = (float) nA;
+            float fnB = (float) nB;
+            float MNR = (float) nCorr / std::min(fnA, fnB);
+            float GNR = (float) nCorr / std::sqrt(fnA * fnB);
+            float DICE = 2.0f * (float) nCorr / (fnA + fnB);
+            CorrFrameStat cs{F.mnId, chA, chB, nCorr, nA, nB, MNR, GNR, DICE};
+            mvStats.emplace_back(cs);
+        }
+    }
+}
 
+int CorrelationMatcher::SearchCorrelated(Frame& F, float th_px, size_t th_str, float nnratio)
+{
+    const int N = F.Ntype;
 
-    // ---------- 2) Create KD-Tree on target channel ---------- //
-    cv::Mat data(vDst.size(), 2, CV_32F);
-    std::vector<MapPoint*> idmap; idmap.reserve(vDst.size());
-    for(size_t i=0;i<vDst.size(); ++i){
-        data.at<float>(i,0) = vDst[i].first.x;
-        data.at<float>(i,1) = vDst[i].first.y;
-        idmap.push_back(vDst[i].second);
+    // ---------- 1) Sources: points matched before this pass (no chaining through new matches) ---------- //
+    using Node = std::pair<cv::Point2f, MapPoint*>;
+    std::vector<Node> vSrc;
+    for(int ch=0; ch<N; ++ch){
+        const auto& C = F.Channels[ch];
+        for(int i=0;i<C.N;++i){
+            MapPoint* p = C.mvpMapPoints[i];
+            if(!p || p->isBad()) continue;
+            vSrc.emplace_back(C.mvKeysUn[i].pt, p);
+        }
     }
-    cv::flann::Index kd(data, cv::flann::KDTreeIndexParams(1));
-
-    // ---------- 3) Radius search and accumulate edges ---------- //
-	std::vector<int>   idxs;
-	std::vector<float> dists;
-	size_t nCorr = 0;
-	const float radius = th_px * th_px;
-
-	for (const auto& ns : vSrc) {
-    	float q[2] = { ns.first.x, ns.first.y };
-    	cv::Mat query(1, 2, CV_32F, q);
-
-    	idxs.clear();  dists.clear();
-    	int nFound = kd.radiusSearch(query,
-                                     idxs,
-                                 	 dists,
-                                 	 radius,
-                                 	 vDst.size(),
-                                 	 cv::flann::SearchParams(INT_MAX, 0, false));
-    	MapPoint* pSrc = ns.second;
-    	for (int k = 0; k < nFound; ++k) {
-        	int id = idxs[k];
-        	MapPoint* pDst = idmap[id];
-        	if (pSrc == pDst) continue;
-
-        	size_t cnt = pSrc->AddEdge(pDst);
-        	if (cnt >= th_str)
-            	++nCorr;
-    	}
-	}
-
-	/*
-	// --------------- Brute force exhaustive matching -------------- //
-
-    size_t nCorr = 0;
-    // size_t nEdges = 0, totHits = 0, maxHits = 0;
+    if(vSrc.empty()) return 0;
 
+    std::vector<DescriptorMetric> vDescriptorDistance;
+    for(int ch=0; ch<N; ++ch)
+        vDescriptorDistance.emplace_back(F.Channels[ch].mDescriptors);
+    const cv::Mat Ow = F.GetCameraCenter();
+
+    // ---------- 2) Partners searched in a th_px window around the source keypoint ---------- //
+    std::vector<size_t> vCandidates;
+    int nMatches = 0;
     for(const auto& ns : vSrc){
-        int hits = 0;
-        for(const auto& nd : vDst){
-            float dx = ns.first.x - nd.first.x;
-            float dy = ns.first.y - nd.first.y;
-            if(dx*dx + dy*dy <= th_px*th_px){
-                //++hits; // DEBUG LOGGING
-                if (ns.second != nd.second) {
-                    size_t counts = ns.second->AddEdge(nd.second);
-                    //++nEdges; // DEBUG LOGGING
-                    if (counts >= th_str)
-                        ++nCorr;
-                }
+        const int chA = ns.second->GetFeatureType();
+        for(MapPoint* pB : ns.second->GetCorrelatedPoints(th_str)){
+            const int chB = pB->GetFeatureType();
+            if(chB<0 || chB>=N || chB==chA || F.IsDeferred(chB)) continue;
+            if(pB->mnLastFrameSeen == F.mnId) continue;   // Already matched in this frame
+            if(pB->isBad()) continue;
+
+            // Scale level predicted from the distance to the camera, as in Frame::isInFrustum
+            const float dist = cv::norm(pB->GetWorldPos() - Ow);
+            if(dist < pB->GetMinDistanceInvariance() || dist > pB->GetMaxDistanceInvariance()) continue;
+            const int nPredictedLevel = pB->PredictScale(dist, &F);
+
+            auto& CB = F.Channels[chB];
+            const std::vector<size_t> vIndices = F.GetFeaturesInArea(chB, ns.first.x, ns.first.y, th_px,
+                                                                     nPredictedLevel - 1, nPredictedLevel);
+            vCandidates.clear();
+            for(const size_t idx : vIndices){
+                MapPoint* pOld = CB.mvpMapPoints[idx];
+                if(pOld && pOld->Observations() > 0) continue;
+                vCandidates.push_back(idx);
             }
+            if(vCandidates.empty()) continue;
+
+            const cv::Mat dB = pB->GetDescriptor();
+            const DescriptorMatch match = vDescriptorDistance[chB].Match(dB.data, CB.mDescriptors,
+                                                                         vCandidates.data(), vCandidates.size());
+            if(match.bestIdx<0 || match.bestDist > Associater::mvTH_HIGH[chB]) continue;
+
+            // Ratio to the second match, when both are at the same scale level
+            const int* pOctave = CB.mKeysUnSoA->octave.data();
+            const int bestLevel = pOctave[match.bestIdx];
+            const int bestLevel2 = match.secondIdx>=0 ? pOctave[match.secondIdx] : -1;
+            if(bestLevel == bestLevel2 && match.bestDist > nnratio * match.secondDist) continue;
+
+            // Same bookkeeping as the points matched before the local map search
+            CB.mvpMapPoints[match.bestIdx] = pB;
+            pB->IncreaseVisible();
+            pB->mnLastFrameSeen = F.mnId;
+            pB->mbTrackInView = false;
+            ++nMatches;
         }
-        //totHits += hits; // DEBUG LOGGING
-        //maxHits  = std::max(maxHits, (size_t)hits); // DEBUG LOGGING
     }
 
-	*/
-
-    // DEBUG LOGGING
-	/*
-    std::cout << "[CM] totHits=" << totHits
-              << " avgHits=" << (double)totHits/vSrc.size()
-              << " maxHits=" << maxHits
-              << " validEdges: " << nEdges
-              << " nCorr: " << nCorr << '\n';
-	*/
-
-    // Save correlation status for evaluation and logging
-    size_t nA = vSrc.size();
-    size_t nB = vDst.size();
-	float fnA = (float) nA;
-	float fnB = (float) nB;
-    float MNR = (float) nCorr / std::min(fnA, fnB);
-	float GNR = (float) nCorr / std::sqrt(fnA * fnB);
-	float DICE = 2.0f * (float) nCorr / (fnA + fnB);
-    CorrFrameStat cs{F.mnId, chA, chB, nCorr, nA, nB, MNR, GNR, DICE};
-    mvStats.emplace_back(cs);
-
-    return MNR;
+    return nMatches;
 }
 
 } // namespace ORB_SLAM2
@@ -0,0 +1,45 @@
+#include "DescriptorIndex.h"
+
+using namespace ::std;
+
+namespace ORB_SLAM2 {
+
+const int DescriptorIndex::LSH_TABLES = 6;
+const int DescriptorIndex::LSH_KEY_SIZE = 16;
+const int DescriptorIndex::LSH_MULTI_PROBE = 2;
+const int DescriptorIndex::KD_TREES = 4;
+const int DescriptorIndex::CHECKS = 32;
+
+DescriptorIndex::DescriptorIndex(const cv::Mat &descriptors) : mDescriptors(descriptors) {
+  if (mDescriptors.empty())
+    return;
+
+  if (!mDescriptors.isContinuous())
+    mDescriptors = mDescriptors.clone();
+
+  if (mDescriptors.depth() == CV_8U)
+    mIndex.build(mDescriptors, cv::flann::LshIndexParams(LSH_TABLES, LSH_KEY_SIZE, LSH_MULTI_PROBE),
+                 cvflann::FLANN_DIST_HAMMING);
+  else
+    mIndex.build(mDescriptors, cv::flann::KDTreeIndexParams(KD_TREES));
+}
+
+void DescriptorIndex::Search(const cv::Mat &Q, const int k, cv::Mat &indices) const {
+  if (Q.empty() || mDescriptors.empty() || k <= 0) {
+    indices = cv::Mat(Q.rows, max(k, 0), CV_32S, cv::Scalar(-1));
+    return;
+  }
+
+  cv::Mat dists;
+  mIndex.knnSearch(Q, indices, dists, k, cv::flann::SearchParams(CHECKS));
+
+  // LSH leaves the slots it could not fill undefined
+  for (int i = 0; i < indices.rows; i++) {
+    int *pIdx = indices.ptr<int>(i);
+    for (int j = 0; j < k; j++)
+      if (pIdx[j] < 0 || pIdx[j] >= mDescriptors.rows)
+        pIdx[j] = -1;
+  }
+}
+
+} // namespace ORB_SLAM2
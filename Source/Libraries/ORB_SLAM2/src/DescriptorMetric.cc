@@ -0,0 +1,296 @@
+#include "DescriptorMetric.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define DESCRIPTOR_METRIC_X86
+#include <immintrin.h>
+#endif
+
+using namespace ::std;
+
+namespace ORB_SLAM2 {
+
+namespace {
+
+#define INLINE inline __attribute__((always_inline))
+
+struct CpuFeatures {
+  bool popcnt = false;
+  bool avx2 = false;
+  bool fma = false;
+  bool avx512popcnt = false;
+};
+
+const CpuFeatures &Cpu() {
+  static const CpuFeatures cpu = []() {
+    CpuFeatures f;
+#ifdef DESCRIPTOR_METRIC_X86
+    __builtin_cpu_init();
+    f.popcnt = __builtin_cpu_supports("popcnt");
+    f.avx2 = __builtin_cpu_supports("avx2");
+    f.fma = __builtin_cpu_supports("fma");
+    f.avx512popcnt = __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") &&
+                     __builtin_cpu_supports("avx512vpopcntdq");
+#endif
+    return f;
+  }();
+  return cpu;
+}
+
+// Runs Pair::Compute over the batch. Inlined into the portable and POPCNT kernels;
+// the AVX kernels repeat it under their own target (GCC cannot inline a target
+// specific function into a generic one).
+template <class Pair>
+INLINE void BatchLoop(const uchar *a, const uchar *B, const size_t step, const size_t *pIdx, const int n,
+                      const int length, float *pDist) {
+  if (pIdx) {
+    for (int k = 0; k < n; k++)
+      pDist[k] = Pair::Compute(a, B + step * pIdx[k], length);
+  } else {
+    for (int k = 0; k < n; k++)
+      pDist[k] = Pair::Compute(a, B + step * k, length);
+  }
+}
+
+// Hamming over 64-bit words, NBYTES = 0: runtime length (byte tail for lengths like 61)
+template <int NBYTES>
+struct HammingWords {
+  static INLINE float Compute(const uchar *a, const uchar *b, const int length) {
+    const int nBytes = NBYTES > 0 ? NBYTES : length;
+    const int nWords = nBytes / 8;
+    int dist = 0;
+    for (int w = 0; w < nWords; w++) {
+      uint64_t wa, wb;
+      memcpy(&wa, a + 8 * w, 8);
+      memcpy(&wb, b + 8 * w, 8);
+      dist += __builtin_popcountll(wa ^ wb);
+    }
+    for (int i = 8 * nWords; i < nBytes; i++)
+      dist += __builtin_popcount(a[i] ^ b[i]);
+    return static_cast<float>(dist);
+  }
+};
+
+// Euclidean with four independent sums
+struct L2Scalar {
+  static INLINE float Compute(const uchar *a8, const uchar *b8, const int length) {
+    const float *a = reinterpret_cast<const float *>(a8);
+    const float *b = reinterpret_cast<const float *>(b8);
+    float s0 = 0.f, s1 = 0.f, s2 = 0.f, s3 = 0.f;
+    int i = 0;
+    for (; i + 4 <= length; i += 4) {
+      const float e0 = a[i] - b[i];
+      const float e1 = a[i + 1] - b[i + 1];
+      const float e2 = a[i + 2] - b[i + 2];
+      const float e3 = a[i + 3] - b[i + 3];
+      s0 += e0 * e0;
+      s1 += e1 * e1;
+      s2 += e2 * e2;
+      s3 += e3 * e3;
+    }
+    for (; i < length; i++)
+      s0 += (a[i] - b[i]) * (a[i] - b[i]);
+    return sqrt((s0 + s1) + (s2 + s3));
+  }
+};
+
+template <int NBYTES>
+void HammingPortable(const uchar *a, const uchar *B, const size_t step, const size_t *pIdx, const int n,
+                     const int length, float *pDist) {
+  BatchLoop<HammingWords<NBYTES>>(a, B, step, pIdx, n, length, pDist);
+}
+
+void L2Portable(const uchar *a, const uchar *B, const size_t step, const size_t *pIdx, const int n, const int length,
+                float *pDist) {
+  BatchLoop<L2Scalar>(a, B, step, pIdx, n, length, pDist);
+}
+
+#ifdef DESCRIPTOR_METRIC_X86
+
+// Same code as HammingPortable, __builtin_popcountll becomes one POPCNT
+template <int NBYTES>
+__attribute__((target("popcnt"))) void HammingPopcnt(const uchar *a, const uchar *B, const size_t step,
+                                                     const size_t *pIdx, const int n, const int length,
+                                                     float *pDist) {
+  BatchLoop<HammingWords<NBYTES>>(a, B, step, pIdx, n, length, pDist);
+}
+
+// Byte popcount by nibble lookup, bytes summed with SAD. NBYTES multiple of 32.
+template <int NBYTES>
+struct HammingAvx2Pair {
+  static inline __attribute__((target("avx2"))) float Compute(const uchar *a, const uchar *b, const int) {
+    const __m256i lut = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                         0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low = _mm256_set1_epi8(0x0f);
+    __m256i acc = _mm256_setzero_si256();
+    for (int i = 0; i < NBYTES; i += 32) {
+      const __m256i x = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i)),
+                                         _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + i)));
+      const __m256i lo = _mm256_and_si256(x, low);
+      const __m256i hi = _mm256_and_si256(_mm256_srli_epi16(x, 4), low);
+      const __m256i cnt = _mm256_add_epi8(_mm256_shuffle_epi8(lut, lo), _mm256_shuffle_epi8(lut, hi));
+      acc = _mm256_add_epi64(acc, _mm256_sad_epu8(cnt, _mm256_setzero_si256()));
+    }
+    const __m128i sum = _mm_add_epi64(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+    return static_cast<float>(_mm_cvtsi128_si64(sum) + _mm_extract_epi64(sum, 1));
+  }
+};
+
+template <int NBYTES>
+__attribute__((target("avx2"))) void HammingAvx2(const uchar *a, const uchar *B, const size_t step,
+                                                 const size_t *pIdx, const int n, const int length, float *pDist) {
+  for (int k = 0; k < n; k++)
+    pDist[k] = HammingAvx2Pair<NBYTES>::Compute(a, B + step * (pIdx ? pIdx[k] : k), length);
+}
+
+// One 512-bit register, bytes past the length are masked off (never loaded)
+struct HammingAvx512Pair {
+  static inline __attribute__((target("avx512f,avx512bw,avx512vpopcntdq"))) float Compute(const uchar *a,
+                                                                                         const uchar *b,
+                                                                                         const int length) {
+    const __mmask64 mask = length >= 64 ? ~0ULL : ((1ULL << length) - 1);
+    const __m512i x = _mm512_xor_si512(_mm512_maskz_loadu_epi8(mask, a), _mm512_maskz_loadu_epi8(mask, b));
+    alignas(64) int64_t vCount[8];
+    _mm512_store_si512(vCount, _mm512_popcnt_epi64(x));
+    return static_cast<float>((vCount[0] + vCount[1]) + (vCount[2] + vCount[3]) + (vCount[4] + vCount[5]) +
+                              (vCount[6] + vCount[7]));
+  }
+};
+
+__attribute__((target("avx512f,avx512bw,avx512vpopcntdq"))) void HammingAvx512(const uchar *a, const uchar *B,
+                                                                             const size_t step,
+                                                                             const size_t *pIdx, const int n,
+                                                                             const int length, float *pDist) {
+  for (int k = 0; k < n; k++)
+    pDist[k] = HammingAvx512Pair::Compute(a, B + step * (pIdx ? pIdx[k] : k), length);
+}
+
+// Euclidean with two FMA accumulators of 8 floats. NDIMS = 0: runtime length, multiple of 8.
+template <int NDIMS>
+struct L2Avx2Pair {
+  static inline __attribute__((target("avx2,fma"))) float Compute(const uchar *a8, const uchar *b8,
+                                                                  const int length) {
+    const int nDims = NDIMS > 0 ? NDIMS : length;
+    const float *a = reinterpret_cast<const float *>(a8);
+    const float *b = reinterpret_cast<const float *>(b8);
+    __m256 s0 = _mm256_setzero_ps();
+    __m256 s1 = _mm256_setzero_ps();
+    int i = 0;
+    for (; i + 16 <= nDims; i += 16) {
+      const __m256 d0 = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+      const __m256 d1 = _mm256_sub_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8));
+      s0 = _mm256_fmadd_ps(d0, d0, s0);
+      s1 = _mm256_fmadd_ps(d1, d1, s1);
+    }
+    for (; i + 8 <= nDims; i += 8) {
+      const __m256 d0 = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+      s0 = _mm256_fmadd_ps(d0, d0, s0);
+    }
+    const __m256 s = _mm256_add_ps(s0, s1);
+    __m128 h = _mm_add_ps(_mm256_castps256_ps128(s), _mm256_extractf128_ps(s, 1));
+    h = _mm_hadd_ps(h, h);
+    h = _mm_hadd_ps(h, h);
+    return sqrt(_mm_cvtss_f32(h));
+  }
+};
+
+template <int NDIMS>
+__attribute__((target("avx2,fma"))) void L2Avx2(const uchar *a, const uchar *B, const size_t step,
+                                                const size_t *pIdx, const int n, const int length, float *pDist) {
+  for (int k = 0; k < n; k++)
+    pDist[k] = L2Avx2Pair<NDIMS>::Compute(a, B + step * (pIdx ? pIdx[k] : k), length);
+}
+
+#endif // DESCRIPTOR_METRIC_X86
+
+#undef INLINE
+
+} // namespace
+
+DescriptorMetric::DescriptorMetric(const cv::Mat &desc) : DescriptorMetric(desc.depth(), desc.cols) {}
+
+DescriptorMetric::DescriptorMetric(const int depth, const int length) : mnDepth(depth), mnLength(length) {
+  const CpuFeatures &cpu = Cpu();
+  (void)cpu;
+
+  if (depth == CV_8U) {
+#ifdef DESCRIPTOR_METRIC_X86
+    if (cpu.avx512popcnt && length <= 64) {
+      mKernel = HammingAvx512;
+      mpName = "hamming/avx512-vpopcntdq";
+      return;
+    }
+    if (cpu.avx2 && length == 32) {
+      mKernel = HammingAvx2<32>;
+      mpName = "hamming32/avx2";
+      return;
+    }
+    if (cpu.avx2 && length == 64) {
+      mKernel = HammingAvx2<64>;
+      mpName = "hamming64/avx2";
+      return;
+    }
+    if (cpu.popcnt) {
+      mKernel = length == 32 ? HammingPopcnt<32> : length == 64 ? HammingPopcnt<64> : HammingPopcnt<0>;
+      mpName = "hamming/popcnt";
+      return;
+    }
+#endif
+    mKernel = length == 32 ? HammingPortable<32> : length == 64 ? HammingPortable<64> : HammingPortable<0>;
+    mpName = "hamming/portable";
+  } else if (depth == CV_32F) {
+#ifdef DESCRIPTOR_METRIC_X86
+    if (cpu.avx2 && cpu.fma && length % 8 == 0) {
+      mKernel = length == 64 ? L2Avx2<64> : length == 128 ? L2Avx2<128> : length == 256 ? L2Avx2<256> : L2Avx2<0>;
+      mpName = "l2/avx2-fma";
+      return;
+    }
+#endif
+    mKernel = L2Portable;
+    mpName = "l2/portable";
+  } else {
+    throw std::runtime_error("[DescriptorMetric] Unsupported descriptor depth " + to_string(depth));
+  }
+}
+
+void DescriptorMetric::Batch(const uchar *a, const uchar *const *ppB, const int n, float *pDist) const {
+  for (int k = 0; k < n; k++)
+    mKernel(a, ppB[k], 0, NULL, 1, mnLength, pDist + k);
+}
+
+DescriptorMatch DescriptorMetric::Match(const uchar *a, const cv::Mat &D, const size_t *pIdx, const int n) const {
+  DescriptorMatch match = {FLT_MAX, -1, FLT_MAX, -1};
+
+  // Distances by blocks on the stack, then the running best two
+  const int BLOCK = 64;
+  float vDist[BLOCK];
+  for (int k0 = 0; k0 < n; k0 += BLOCK) {
+    const int m = min(BLOCK, n - k0);
+    mKernel(a, D.data, D.step[0], pIdx + k0, m, mnLength, vDist);
+    for (int k = 0; k < m; k++) {
+      const float dist = vDist[k];
+      if (dist < match.bestDist) {
+        match.secondDist = match.bestDist;
+        match.secondIdx = match.bestIdx;
+        match.bestDist = dist;
+        match.bestIdx = static_cast<int>(pIdx[k0 + k]);
+      } else if (dist < match.secondDist) {
+        match.secondDist = dist;
+        match.secondIdx = static_cast<int>(pIdx[k0 + k]);
+      }
+    }
+  }
+  return match;
+}
+
+float DescriptorMetric::Distance(const cv::Mat &a, const cv::Mat &b) {
+  return DescriptorMetric(a)(a, b);
+}
+
+} // namespace ORB_SLAM2
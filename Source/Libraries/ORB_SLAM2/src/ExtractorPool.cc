@@ -0,0 +1,124 @@
+#include "ExtractorPool.h"
+#include "Perf.h"
+#include "ThreadBudget.h"
+
+#include <algorithm>
+
+using namespace ::std;
+
+namespace ORB_SLAM2 {
+
+ExtractorPool::ExtractorPool(const int Ntype, int nThreads)
+    : mvQueues(max(Ntype, 1)),
+      mvRunMs(max(Ntype, 1), 0.0),
+      mvLastRunMs(max(Ntype, 1), 0.0),
+      mnPending(0),
+      mnNextQueue(0),
+      mbTimed(false),
+      mbStop(false) {
+  if (nThreads <= 0) {
+    const int nHardware = static_cast<int>(thread::hardware_concurrency());
+    nThreads = min(max(nHardware, 1), 2 * max(Ntype, 1));
+  }
+
+  mvWorkers.reserve(nThreads);
+  for (int i = 0; i < nThreads; i++)
+    mvWorkers.emplace_back(&ExtractorPool::Run, this);
+}
+
+ExtractorPool::~ExtractorPool() {
+  {
+    unique_lock<mutex> lock(mMutex);
+    mbStop = true;
+  }
+  mCondTask.notify_all();
+
+  for (size_t i = 0; i < mvWorkers.size(); i++)
+    mvWorkers[i].join();
+}
+
+void ExtractorPool::Submit(const int Ftype, function<void()> task, const bool bTimed) {
+  {
+    unique_lock<mutex> lock(mMutex);
+    const size_t queue = Ftype % mvQueues.size();
+    mvQueues[queue].push_back({std::move(task), chrono::steady_clock::now(), queue, bTimed});
+    mnPending++;
+    mbTimed = mbTimed || bTimed;
+  }
+  mCondTask.notify_one();
+}
+
+void ExtractorPool::Wait() {
+  exception_ptr pError;
+  {
+    unique_lock<mutex> lock(mMutex);
+    mCondDone.wait(lock, [this] { return mnPending == 0; });
+    swap(pError, mpError);
+    // Untimed batches keep the run times of the last extraction
+    if (mbTimed) {
+      mvLastRunMs.swap(mvRunMs);
+      fill(mvRunMs.begin(), mvRunMs.end(), 0.0);
+      mbTimed = false;
+    }
+  }
+
+  if (pError)
+    rethrow_exception(pError);
+}
+
+// Called with mMutex held. Visits the channel queues round-robin.
+bool ExtractorPool::PopTask(Task &task) {
+  const size_t nQueues = mvQueues.size();
+  for (size_t k = 0; k < nQueues; k++) {
+    deque<Task> &queue = mvQueues[(mnNextQueue + k) % nQueues];
+    if (queue.empty())
+      continue;
+
+    task = std::move(queue.front());
+    queue.pop_front();
+    mnNextQueue = (mnNextQueue + k + 1) % nQueues;
+    return true;
+  }
+  return false;
+}
+
+void ExtractorPool::Run() {
+  ThreadBudget::pinCurrentThread(ThreadBudget::TRACKING);
+
+  while (true) {
+    Task task;
+    {
+      unique_lock<mutex> lock(mMutex);
+      mCondTask.wait(lock, [&] { return mbStop || PopTask(task); });
+      if (!task.fn)
+        return;
+    }
+
+    const auto t0 = chrono::steady_clock::now();
+    if (task.bTimed)
+      Perf::record("Extract Queue", chrono::duration<double, milli>(t0 - task.tEnqueue).count());
+
+    exception_ptr pError;
+    try {
+      task.fn();
+    } catch (...) {
+      pError = current_exception();
+    }
+
+    const double runMs = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+    if (task.bTimed)
+      Perf::record("Extract Run", runMs);
+
+    {
+      unique_lock<mutex> lock(mMutex);
+      if (task.bTimed)
+        mvRunMs[task.queue] += runMs;
+      if (pError && !mpError)
+        mpError = pError;
+      if (--mnPending == 0)
+        mCondDone.notify_all();
+    }
+  }
+}
+
+} // namespace ORB_SLAM2
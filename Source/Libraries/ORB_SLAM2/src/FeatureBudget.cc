@@ -0,0 +1,153 @@
+#include "FeatureBudget.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <numeric>
+
+using namespace ::std;
+
+namespace ORB_SLAM2 {
+
+FeatureBudget::FeatureBudget(const cv::FileNode &node, const vector<int> &vnFeatures,
+                             const vector<cv::FileNode> &vExtractorConfigs)
+    : mvnBudget(vnFeatures),
+      mvWindow(vnFeatures.size()),
+      mnFramesSinceUpdate(0) {
+  mbEnabled   = node.empty() || node["enabled"].empty() ? false : ((int)node["enabled"] != 0);
+  mnTotal     = node.empty() || node["total"].empty() ? 0 : (int)node["total"];
+  mnWindow    = node.empty() || node["window"].empty() ? 30 : (int)node["window"];
+  mnPeriod    = node.empty() || node["period"].empty() ? 10 : (int)node["period"];
+  mSmoothing  = node.empty() || node["smoothing"].empty() ? 0.3f : (float)node["smoothing"];
+  mCostWeight = node.empty() || node["cost_weight"].empty() ? 0.5f : (float)node["cost_weight"];
+  const float minRatio = node.empty() || node["min_ratio"].empty() ? 0.25f : (float)node["min_ratio"];
+  const float maxRatio = node.empty() || node["max_ratio"].empty() ? 2.0f : (float)node["max_ratio"];
+
+  mnWindow = max(mnWindow, 1);
+  mnPeriod = max(mnPeriod, 1);
+  mSmoothing = min(max(mSmoothing, 0.0f), 1.0f);
+
+  if (mnTotal <= 0)
+    mnTotal = accumulate(vnFeatures.begin(), vnFeatures.end(), 0);
+
+  const size_t Ntype = vnFeatures.size();
+  mvnMin.resize(Ntype);
+  mvnMax.resize(Ntype);
+  for (size_t i = 0; i < Ntype; i++) {
+    const cv::FileNode &cfg = vExtractorConfigs[i];
+    mvnMin[i] = cfg["nFeaturesMin"].empty() ? cvRound(vnFeatures[i] * minRatio) : (int)cfg["nFeaturesMin"];
+    mvnMax[i] = cfg["nFeaturesMax"].empty() ? cvRound(vnFeatures[i] * maxRatio) : (int)cfg["nFeaturesMax"];
+    // A budget of 0 means "unlimited" for some OpenCV detectors
+    mvnMin[i] = max(mvnMin[i], 1);
+    mvnMax[i] = max(mvnMax[i], mvnMin[i]);
+  }
+}
+
+void FeatureBudget::InfoConfigs() const {
+  cout << endl << "Feature Budget: " << (mbEnabled ? "adaptive" : "fixed") << endl;
+  if (!mbEnabled)
+    return;
+
+  cout << "- Total Features: " << mnTotal << endl;
+  cout << "- Window / Period: " << mnWindow << " / " << mnPeriod << " frames" << endl;
+  cout << "- Smoothing: " << mSmoothing << endl;
+  cout << "- Cost Weight: " << mCostWeight << endl;
+  for (size_t i = 0; i < mvnBudget.size(); i++)
+    cout << "  - [Feature " << i << "] " << mvnBudget[i] << " in [" << mvnMin[i] << ", " << mvnMax[i] << "]" << endl;
+}
+
+bool FeatureBudget::AddFrame(const vector<int> &vnKeys, const vector<int> &vnInliers,
+                             const vector<double> &vCostMs, const vector<bool> &vbSampled) {
+  if (!mbEnabled)
+    return false;
+
+  for (size_t i = 0; i < mvWindow.size(); i++) {
+    if (!vbSampled[i])
+      continue;
+    mvWindow[i].push_back({vnKeys[i], vnInliers[i], vCostMs[i]});
+    if ((int)mvWindow[i].size() > mnWindow)
+      mvWindow[i].pop_front();
+  }
+
+  // At least two channels with a full window are needed to move keypoints between them
+  int nFull = 0;
+  for (size_t i = 0; i < mvWindow.size(); i++)
+    if ((int)mvWindow[i].size() >= mnWindow)
+      nFull++;
+  if (++mnFramesSinceUpdate < mnPeriod || nFull < 2)
+    return false;
+  mnFramesSinceUpdate = 0;
+
+  const vector<int> vnPrevious = mvnBudget;
+  Reallocate();
+  return mvnBudget != vnPrevious;
+}
+
+void FeatureBudget::Reallocate() {
+  const size_t Ntype = mvnBudget.size();
+
+  // Channels without a full window keep their budget
+  vector<double> vTarget(Ntype, 0.0);
+  vector<bool> vbFixed(Ntype, false);
+  for (size_t i = 0; i < Ntype; i++) {
+    if ((int)mvWindow[i].size() < mnWindow) {
+      vTarget[i] = mvnBudget[i];
+      vbFixed[i] = true;
+    }
+  }
+
+  // Inlier yield per keypoint, discounted by the time spent per keypoint
+  vector<double> vScore(Ntype, 0.0);
+  double sumScore = 0.0;
+  for (size_t i = 0; i < Ntype; i++) {
+    if (vbFixed[i])
+      continue;
+    double nKeys = 0.0, nInliers = 0.0, costMs = 0.0;
+    for (const Sample &s : mvWindow[i]) {
+      nKeys += s.nKeys;
+      nInliers += s.nInliers;
+      costMs += s.costMs;
+    }
+    if (nKeys <= 0.0)
+      continue;
+
+    const double costPerKey = max(costMs / nKeys, 1e-6);
+    vScore[i] = (nInliers / nKeys) / pow(costPerKey, (double)mCostWeight);
+    sumScore += vScore[i];
+  }
+  if (sumScore <= 0.0)
+    return;
+
+  // Proportional split; channels hitting a bound are fixed there and the rest is re-split
+  for (size_t iter = 0; iter < Ntype; iter++) {
+    double nFree = mnTotal, scoreFree = 0.0;
+    for (size_t i = 0; i < Ntype; i++) {
+      if (vbFixed[i])
+        nFree -= vTarget[i];
+      else
+        scoreFree += vScore[i];
+    }
+
+    bool bClamped = false;
+    for (size_t i = 0; i < Ntype; i++) {
+      if (vbFixed[i])
+        continue;
+      const double t = scoreFree > 0.0 ? nFree * vScore[i] / scoreFree : mvnMin[i];
+      vTarget[i] = t;
+      if (t < mvnMin[i] || t > mvnMax[i]) {
+        vTarget[i] = t < mvnMin[i] ? mvnMin[i] : mvnMax[i];
+        vbFixed[i] = true;
+        bClamped = true;
+      }
+    }
+    if (!bClamped)
+      break;
+  }
+
+  for (size_t i = 0; i < Ntype; i++) {
+    const int n = cvRound(mvnBudget[i] + mSmoothing * (vTarget[i] - mvnBudget[i]));
+    mvnBudget[i] = min(max(n, mvnMin[i]), mvnMax[i]);
+  }
+}
+
+} // namespace ORB_SLAM2
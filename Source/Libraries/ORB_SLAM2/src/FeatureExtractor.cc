@@ -8,11 +8,12 @@ namespace ORB_SLAM2 {
 FeatureExtractor::FeatureExtractor(int _nfeatures, float _scaleFactor,
                                    int _nlevels, int _iniThFAST, int _minThFAST)
     : nfeatures(_nfeatures), scaleFactor(_scaleFactor), nlevels(_nlevels),
-      iniThFAST(_iniThFAST), minThFAST(_minThFAST) {
+      iniThFAST(_iniThFAST), minThFAST(_minThFAST), mpPyramidCache(NULL) {
   FeatureExtractor::InitPyramidParameters();
 }
 
-FeatureExtractor::FeatureExtractor(const cv::FileNode& config, bool init) {
+FeatureExtractor::FeatureExtractor(const cv::FileNode& config, bool init)
+    : mpPyramidCache(NULL) {
   nfeatures   = config["nFeatures"].empty()    ? 2000 : (int)config["nFeatures"];
   scaleFactor = config["scaleFactor"].empty()  ? 1.2f : (float)config["scaleFactor"];
   nlevels     = config["nLevels"].empty()      ? 8    : (int)config["nLevels"];
@@ -62,19 +63,7 @@ void FeatureExtractor::InitPyramidParameters() {
 
   mvImagePyramid.resize(nlevels);
 
-  mnFeaturesPerLevel.resize(nlevels);
-  float factor = 1.0f / scaleFactor;
-  float nDesiredFeaturesPerScale =
-      nfeatures * (1 - factor) /
-      (1 - (float)pow((double)factor, (double)nlevels));
-
-  int sumFeatures = 0;
-  for (int level = 0; level < nlevels - 1; level++) {
-    mnFeaturesPerLevel[level] = cvRound(nDesiredFeaturesPerScale);
-    sumFeatures += mnFeaturesPerLevel[level];
-    nDesiredFeaturesPerScale *= factor;
-  }
-  mnFeaturesPerLevel[nlevels - 1] = std::max(nfeatures - sumFeatures, 0);
+  ComputeFeaturesPerLevel();
 
   // This is for orientation
   // pre-compute the end of a row in a circular patch
@@ -95,30 +84,35 @@ void FeatureExtractor::InitPyramidParameters() {
   }
 }
 
+void FeatureExtractor::ComputeFeaturesPerLevel() {
+  mnFeaturesPerLevel.resize(nlevels);
+  float factor = 1.0f / scaleFactor;
+  float nDesiredFeaturesPerScale =
+      nfeatures * (1 - factor) /
+      (1 - (float)pow((double)factor, (double)nlevels));
+
+  int sumFeatures = 0;
+  for (int level = 0; level < nlevels - 1; level++) {
+    mnFeaturesPerLevel[level] = cvRound(nDesiredFeaturesPerScale);
+    sumFeatures += mnFeaturesPerLevel[level];
+    nDesiredFeaturesPerScale *= factor;
+  }
+  mnFeaturesPerLevel[nlevels - 1] = std::max(nfeatures - sumFeatures, 0);
+}
+
+void FeatureExtractor::SetNumFeatures(int n) {
+  nfeatures = std::max(n, 0);
+  ComputeFeaturesPerLevel();
+}
+
 void FeatureExtractor::ComputePyramid(cv::Mat image) {
-  for (int level = 0; level < nlevels; ++level) {
-    float scale = mvInvScaleFactor[level];
-    cv::Size sz(cvRound((float)image.cols * scale),
-            cvRound((float)image.rows * scale));
-    cv::Size wholeSize(sz.width + EDGE_THRESHOLD * 2,
-                   sz.height + EDGE_THRESHOLD * 2);
-    cv::Mat temp(wholeSize, image.type()), masktemp;
-    mvImagePyramid[level] =
-        temp(cv::Rect(EDGE_THRESHOLD, EDGE_THRESHOLD, sz.width, sz.height));
-
-    // Compute the resized image
-    if (level != 0) {
-      cv::resize(mvImagePyramid[level - 1], mvImagePyramid[level], sz, 0, 0,
-             cv::INTER_LINEAR);
-
-      cv::copyMakeBorder(mvImagePyramid[level], temp, EDGE_THRESHOLD,
-                     EDGE_THRESHOLD, EDGE_THRESHOLD, EDGE_THRESHOLD,
-                     cv::BORDER_REFLECT_101 + cv::BORDER_ISOLATED);
-    } else {
-      cv::copyMakeBorder(image, temp, EDGE_THRESHOLD, EDGE_THRESHOLD,
-                     EDGE_THRESHOLD, EDGE_THRESHOLD, cv::BORDER_REFLECT_101);
-    }
+  // Reuse the pyramid another channel already built for this frame
+  if (mpPyramidCache && mpPyramidCache->Holds(image)) {
+    mvImagePyramid = mpPyramidCache->Get(scaleFactor, nlevels, EDGE_THRESHOLD, mvInvScaleFactor);
+    return;
   }
+
+  ImagePyramidCache::Build(image, mvInvScaleFactor, EDGE_THRESHOLD, mvPyramidBuffers, mvImagePyramid);
 }
 
 } // namespace ORB_SLAM2
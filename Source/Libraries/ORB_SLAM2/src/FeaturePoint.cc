@@ -1,7 +1,140 @@
 #include <FeaturePoint.h>
 
+#include <algorithm>
+#include <cmath>
+
 using namespace ::std;
 
 namespace ORB_SLAM2 {
 
-}
\ No newline at end of file
+void KeyPointArray::Assign(const vector<cv::KeyPoint> &vKeys) {
+  const size_t n = vKeys.size();
+  x.resize(n);
+  y.resize(n);
+  octave.resize(n);
+  for (size_t i = 0; i < n; i++) {
+    const cv::KeyPoint &kp = vKeys[i];
+    x[i] = kp.pt.x;
+    y[i] = kp.pt.y;
+    octave[i] = kp.octave;
+  }
+}
+
+void KeyPointArray::Clear() {
+  x.clear();
+  y.clear();
+  octave.clear();
+}
+
+const float FeatureGrid::MIN_CELL_SIZE = 8.0f;
+const float FeatureGrid::MAX_CELL_SIZE = 64.0f;
+
+void FeatureGrid::Assign(const KeyPointArray &keys, const float minX, const float maxX, const float minY,
+                         const float maxY) {
+  const float width = maxX - minX;
+  const float height = maxY - minY;
+  const int nKeys = keys.Size();
+  if (nKeys == 0 || width <= 0 || height <= 0) {
+    Clear();
+    return;
+  }
+
+  // Square cells holding one keypoint on average
+  const float cellSize = min(max(sqrt(width * height / nKeys), MIN_CELL_SIZE), MAX_CELL_SIZE);
+  mnCols = max(1, (int)ceil(width / cellSize));
+  mnRows = max(1, (int)ceil(height / cellSize));
+  mMinX = minX;
+  mMinY = minY;
+  mfCellWidthInv = static_cast<float>(mnCols) / width;
+  mfCellHeightInv = static_cast<float>(mnRows) / height;
+
+  // Keypoint's coordinates are undistorted, which could cause to go out of the image
+  const float *pX = keys.x.data();
+  const float *pY = keys.y.data();
+  auto cellOf = [&](const int i) {
+    const int cx = (int)floor((pX[i] - mMinX) * mfCellWidthInv);
+    const int cy = (int)floor((pY[i] - mMinY) * mfCellHeightInv);
+    if (cx < 0 || cx >= mnCols || cy < 0 || cy >= mnRows)
+      return -1;
+    return cy * mnCols + cx;
+  };
+
+  // Counting sort: count, prefix sum to cell ends, then fill each cell backwards so
+  // indices stay increasing within a cell and mvOffsets ends up holding cell starts
+  const int nCells = mnCols * mnRows;
+  mvOffsets.assign(nCells + 1, 0);
+  for (int i = 0; i < nKeys; i++) {
+    const int c = cellOf(i);
+    if (c >= 0)
+      mvOffsets[c]++;
+  }
+  for (int c = 1; c < nCells; c++)
+    mvOffsets[c] += mvOffsets[c - 1];
+  mvOffsets[nCells] = mvOffsets[nCells - 1];
+
+  mvIndices.resize(mvOffsets[nCells]);
+  for (int i = nKeys - 1; i >= 0; i--) {
+    const int c = cellOf(i);
+    if (c >= 0)
+      mvIndices[--mvOffsets[c]] = i;
+  }
+}
+
+void FeatureGrid::Clear() {
+  mnCols = 0;
+  mnRows = 0;
+  mvOffsets.clear();
+  mvIndices.clear();
+}
+
+void FeatureGrid::GetFeaturesInArea(const KeyPointArray &keys, const float x, const float y, const float r,
+                                    const int minLevel, const int maxLevel, vector<size_t> &vIndices) const {
+  if (mvOffsets.empty())
+    return;
+
+  const int nMinCellX = max(0, (int)floor((x - mMinX - r) * mfCellWidthInv));
+  if (nMinCellX >= mnCols)
+    return;
+
+  const int nMaxCellX = min(mnCols - 1, (int)floor((x - mMinX + r) * mfCellWidthInv));
+  if (nMaxCellX < 0)
+    return;
+
+  const int nMinCellY = max(0, (int)floor((y - mMinY - r) * mfCellHeightInv));
+  if (nMinCellY >= mnRows)
+    return;
+
+  const int nMaxCellY = min(mnRows - 1, (int)floor((y - mMinY + r) * mfCellHeightInv));
+  if (nMaxCellY < 0)
+    return;
+
+  const bool bCheckLevels = (minLevel > 0) || (maxLevel >= 0);
+
+  const float *pX = keys.x.data();
+  const float *pY = keys.y.data();
+  const int *pOctave = keys.octave.data();
+
+  // The cells of a row are adjacent in mvIndices: one range per row
+  for (int iy = nMinCellY; iy <= nMaxCellY; iy++) {
+    const uint32_t begin = mvOffsets[iy * mnCols + nMinCellX];
+    const uint32_t end = mvOffsets[iy * mnCols + nMaxCellX + 1];
+    for (uint32_t j = begin; j < end; j++) {
+      const uint32_t idx = mvIndices[j];
+      if (bCheckLevels) {
+        if (pOctave[idx] < minLevel)
+          continue;
+        if (maxLevel >= 0)
+          if (pOctave[idx] > maxLevel)
+            continue;
+      }
+
+      const float distx = pX[idx] - x;
+      const float disty = pY[idx] - y;
+
+      if (fabs(distx) < r && fabs(disty) < r)
+        vIndices.push_back(idx);
+    }
+  }
+}
+
+}
@@ -21,7 +21,9 @@
 #include "Frame.h"
 // #include "Converter.h"
 #include "Associater.h"
-#include <thread>
+#include "DescriptorMetric.h"
+
+#include <climits>
 
 using namespace ::std;
 
@@ -31,7 +33,7 @@ long unsigned int Frame::nNextId = 0;
 bool Frame::mbInitialComputations = true;
 float Frame::cx, Frame::cy, Frame::fx, Frame::fy, Frame::invfx, Frame::invfy;
 float Frame::mnMinX, Frame::mnMinY, Frame::mnMaxX, Frame::mnMaxY;
-float Frame::mfGridElementWidthInv, Frame::mfGridElementHeightInv;
+UndistortionMap Frame::mUndistortionMap;
 
 Frame::Frame(int Ntype) {
   Channels.resize(Ntype);
@@ -49,6 +51,7 @@ Frame::Frame(const Frame &frame)
       mb(frame.mb),
       mThDepth(frame.mThDepth), 
       Channels(frame.Channels), 
+      mvbDeferred(frame.mvbDeferred),
       mnId(frame.mnId), 
       mpReferenceKF(frame.mpReferenceKF),
       mnScaleLevels(frame.mnScaleLevels), 
@@ -76,14 +79,16 @@ Frame::Frame(const Frame &frame)
 // Stereo
 Frame::Frame(const cv::Mat &imLeft, const cv::Mat &imRight, const double &timeStamp, 
              std::vector<FeatureExtractor *> extractorLeft, std::vector<FeatureExtractor *> extractorRight,
-             vector<FbowVocabulary *> voc, cv::Mat &K,
-             cv::Mat &distCoef, const float &bf, const float &thDepth, int Ntype)
+             ExtractorPool *pool, vector<FbowVocabulary *> voc, cv::Mat &K,
+             cv::Mat &distCoef, const float &bf, const float &thDepth, int Ntype,
+             const vector<bool> &vbDeferred)
     : mpVocabulary(voc), 
       mTimeStamp(timeStamp),
       mK(K.clone()), 
       mDistCoef(distCoef.clone()), 
       mbf(bf), 
       mThDepth(thDepth),
+      mvbDeferred(vbDeferred),
       mpReferenceKF(static_cast<KeyFrame *>(NULL)),
       mpFeatureExtractorLeft(extractorLeft),
       mpFeatureExtractorRight(extractorRight),
@@ -106,9 +111,6 @@ Frame::Frame(const cv::Mat &imLeft, const cv::Mat &imRight, const double &timeSt
   if (mbInitialComputations) {
     ComputeImageBounds(imLeft);
 
-    mfGridElementWidthInv = static_cast<float>(FRAME_GRID_COLS) / static_cast<float>(mnMaxX - mnMinX);
-    mfGridElementHeightInv = static_cast<float>(FRAME_GRID_ROWS) / static_cast<float>(mnMaxY - mnMinY);
-
     fx = K.at<float>(0, 0);
     fy = K.at<float>(1, 1);
     cx = K.at<float>(0, 2);
@@ -121,24 +123,37 @@ Frame::Frame(const cv::Mat &imLeft, const cv::Mat &imRight, const double &timeSt
 
   mb = mbf / fx;
 
-  thread CompFeaturesThread[Ntype];
+  if (!mvbDeferred.empty()) {
+    mImLeft = imLeft;
+    mImRight = imRight;
+  }
 
-  for (int Ftype = 0; Ftype < Ntype; Ftype++)
-    CompFeaturesThread[Ftype] = thread(&Frame::ComputeFeaturesStereo, this, Ftype, imLeft, imRight);
-    
-  for (int Ftype = 0; Ftype < Ntype; Ftype++)
-    CompFeaturesThread[Ftype].join();
+  // Left and right extraction of every channel are independent tasks
+  for (int Ftype = 0; Ftype < Ntype; Ftype++) {
+    if (IsDeferred(Ftype))
+      continue;
+    pool->Submit(Ftype, [this, Ftype, &imLeft]() { ExtractFeatures(Ftype, 0, imLeft); });
+    pool->Submit(Ftype, [this, Ftype, &imRight]() { ExtractFeatures(Ftype, 1, imRight); });
+  }
+  pool->Wait();
 
-  // for (int Ftype = 0; Ftype < Ntype; Ftype++)
-  //   ComputeFeaturesStereo(Ftype, imLeft, imRight);
+  // Stereo matching needs both images of a channel. Untimed: the pool keeps the extraction
+  // times of the batch above as the channels' cost
+  for (int Ftype = 0; Ftype < Ntype; Ftype++) {
+    if (IsDeferred(Ftype))
+      ClearChannel(Ftype);
+    else
+      pool->Submit(Ftype, [this, Ftype]() { ComputeFeaturesStereo(Ftype); }, false);
+  }
+  pool->Wait();
 }
 
 // RGB-D
 Frame::Frame(const cv::Mat &imGray, const cv::Mat &imDepth,
              const double &timeStamp, 
-             std::vector<FeatureExtractor *> extractor,
+             std::vector<FeatureExtractor *> extractor, ExtractorPool *pool,
              vector<FbowVocabulary *> voc, cv::Mat &K, cv::Mat &distCoef, const float &bf,
-             const float &thDepth, int Ntype)
+             const float &thDepth, int Ntype, const vector<bool> &vbDeferred)
     : mpVocabulary(voc), 
       mTimeStamp(timeStamp), 
       mK(K.clone()), 
@@ -173,9 +188,6 @@ Frame::Frame(const cv::Mat &imGray, const cv::Mat &imDepth,
   if (mbInitialComputations) {
     ComputeImageBounds(imGray);
 
-    mfGridElementWidthInv = static_cast<float>(FRAME_GRID_COLS) / static_cast<float>(mnMaxX - mnMinX);
-    mfGridElementHeightInv = static_cast<float>(FRAME_GRID_ROWS) / static_cast<float>(mnMaxY - mnMinY);
-
     fx = K.at<float>(0, 0);
     fy = K.at<float>(1, 1);
     cx = K.at<float>(0, 2);
@@ -188,21 +200,27 @@ Frame::Frame(const cv::Mat &imGray, const cv::Mat &imDepth,
 
   mb = mbf / fx;
 
-  thread CompFeaturesThread[Ntype];
-
-  for (int Ftype = 0; Ftype < Ntype; Ftype++)
-    CompFeaturesThread[Ftype] = thread(&Frame::ComputeFeaturesRGBD, this, Ftype, imGray, imDepth);
-    
-  for (int Ftype = 0; Ftype < Ntype; Ftype++)
-    CompFeaturesThread[Ftype].join();
+  mvbDeferred = vbDeferred;
+  if (!mvbDeferred.empty()) {
+    mImLeft = imGray;
+    mImDepth = imDepth;
+  }
 
+  for (int Ftype = 0; Ftype < Ntype; Ftype++) {
+    if (IsDeferred(Ftype))
+      ClearChannel(Ftype);
+    else
+      pool->Submit(Ftype, [this, Ftype, &imGray, &imDepth]() { ComputeFeaturesRGBD(Ftype, imGray, imDepth); });
+  }
+  pool->Wait();
 }
 
 // Mono
 Frame::Frame(const cv::Mat &imGray, const double &timeStamp,
-             std::vector<FeatureExtractor *> extractor,
+             std::vector<FeatureExtractor *> extractor, ExtractorPool *pool,
              vector<FbowVocabulary *> voc, cv::Mat &K,
-             cv::Mat &distCoef, const float &bf, const float &thDepth, int Ntype)
+             cv::Mat &distCoef, const float &bf, const float &thDepth, int Ntype,
+             const vector<bool> &vbDeferred)
     : mpVocabulary(voc),
       mTimeStamp(timeStamp), 
       mK(K.clone()), 
@@ -237,9 +255,6 @@ Frame::Frame(const cv::Mat &imGray, const double &timeStamp,
   if (mbInitialComputations) {
     ComputeImageBounds(imGray);
 
-    mfGridElementWidthInv = static_cast<float>(FRAME_GRID_COLS) / static_cast<float>(mnMaxX - mnMinX);
-    mfGridElementHeightInv = static_cast<float>(FRAME_GRID_ROWS) / static_cast<float>(mnMaxY - mnMinY);
-
     fx = K.at<float>(0, 0);
     fy = K.at<float>(1, 1);
     cx = K.at<float>(0, 2);
@@ -252,60 +267,82 @@ Frame::Frame(const cv::Mat &imGray, const double &timeStamp,
 
   mb = mbf / fx;
 
-  thread CompFeaturesThread[Ntype];
-  
-  for (int Ftype = 0; Ftype < Ntype; Ftype++)
-    CompFeaturesThread[Ftype] = thread(&Frame::ComputeFeaturesMono, this, Ftype, imGray);
+  mvbDeferred = vbDeferred;
+  if (!mvbDeferred.empty())
+    mImLeft = imGray;
 
-  for (int Ftype = 0; Ftype < Ntype; Ftype++)
-    CompFeaturesThread[Ftype].join();
+  for (int Ftype = 0; Ftype < Ntype; Ftype++) {
+    if (IsDeferred(Ftype))
+      ClearChannel(Ftype);
+    else
+      pool->Submit(Ftype, [this, Ftype, &imGray]() { ComputeFeaturesMono(Ftype, imGray); });
+  }
+  pool->Wait();
 }
 
-void Frame::AssignFeaturesToGrid(const int Ftype) {
-  int nReserve = 0.5f * Channels[Ftype].N / (FRAME_GRID_COLS * FRAME_GRID_ROWS);
-  Channels[Ftype].mGrid.resize(FRAME_GRID_COLS);
-  for (unsigned int i = 0; i < FRAME_GRID_COLS; i++) {
-    Channels[Ftype].mGrid[i].resize(FRAME_GRID_ROWS);
-    for (unsigned int j = 0; j < FRAME_GRID_ROWS; j++) {
-      Channels[Ftype].mGrid[i][j].reserve(nReserve);
-    }
-  }
- 
-  for (int i = 0; i < Channels[Ftype].N; i++) {
-    const cv::KeyPoint &kp = Channels[Ftype].mvKeysUn[i];
+vector<int> Frame::ExtractDeferredChannels(ExtractorPool *pool) {
+  vector<int> vFtypes;
+  for (int Ftype = 0; Ftype < Ntype; Ftype++)
+    if (IsDeferred(Ftype))
+      vFtypes.push_back(Ftype);
 
-    int nGridPosX, nGridPosY;
-    if (PosInGrid(kp, nGridPosX, nGridPosY))
-      Channels[Ftype].mGrid[nGridPosX][nGridPosY].push_back(i);
-  }
-}
+  if (vFtypes.empty() || mImLeft.empty())
+    return vector<int>();
 
-//rewrite AssignFeaturesToGrid()
-void Frame::AssignFeaturesToGrid(const int &refN, const vector<cv::KeyPoint> &KeysUn,vector<vector<vector<size_t>>> &Grid) {
-  int nReserve = 0.5f * refN / (FRAME_GRID_COLS * FRAME_GRID_ROWS);
-  Grid.resize(FRAME_GRID_COLS);
-  for (unsigned int i = 0; i < FRAME_GRID_COLS; i++) {
-    Grid[i].resize(FRAME_GRID_ROWS);
-    for (unsigned int j = 0; j < FRAME_GRID_ROWS; j++) {
-      Grid[i][j].reserve(nReserve);
+  // The sensor is told by the images kept: stereo (right), RGB-D (depth) or monocular
+  if (!mImRight.empty()) {
+    for (const int Ftype : vFtypes) {
+      pool->Submit(Ftype, [this, Ftype]() { ExtractFeatures(Ftype, 0, mImLeft); });
+      pool->Submit(Ftype, [this, Ftype]() { ExtractFeatures(Ftype, 1, mImRight); });
     }
+    pool->Wait();
+
+    for (const int Ftype : vFtypes)
+      pool->Submit(Ftype, [this, Ftype]() { ComputeFeaturesStereo(Ftype); }, false);
+  } else if (!mImDepth.empty()) {
+    for (const int Ftype : vFtypes)
+      pool->Submit(Ftype, [this, Ftype]() { ComputeFeaturesRGBD(Ftype, mImLeft, mImDepth); });
+  } else {
+    for (const int Ftype : vFtypes)
+      pool->Submit(Ftype, [this, Ftype]() { ComputeFeaturesMono(Ftype, mImLeft); });
   }
+  pool->Wait();
 
-  for (int i = 0; i < refN; i++) {
-    const cv::KeyPoint &kp = KeysUn[i];
+  mvbDeferred.clear();
+  mImLeft.release();
+  mImRight.release();
+  mImDepth.release();
 
-    int nGridPosX, nGridPosY;
-    if (PosInGrid(kp, nGridPosX, nGridPosY))
-      Grid[nGridPosX][nGridPosY].push_back(i);
-  }
+  return vFtypes;
+}
+
+void Frame::ClearChannel(const int Ftype) {
+  FeaturePoint &channel = Channels[Ftype];
+  channel.N = 0;
+  channel.mvKeys.clear();
+  channel.mvKeysRight.clear();
+  channel.mvKeysUn.clear();
+  channel.mKeysUnSoA.clear();
+  channel.mvuRight.clear();
+  channel.mvDepth.clear();
+  channel.mDescriptors.release();
+  channel.mDescriptorsRight.release();
+  channel.mvpMapPoints.clear();
+  channel.mvbOutlier.clear();
+  channel.mGrid.clear();
+}
+
+void Frame::AssignFeaturesToGrid(const int Ftype) {
+  FeaturePoint &channel = Channels[Ftype];
+  channel.mGrid.edit().Assign(channel.mKeysUnSoA, mnMinX, mnMaxX, mnMinY, mnMaxY);
 }
 
 void Frame::ExtractFeatures(const int Ftype, int imageFlag, const cv::Mat &im) {
   if (imageFlag == 0) {
-    (*mpFeatureExtractorLeft[Ftype])(im, cv::Mat(), Channels[Ftype].mvKeys, Channels[Ftype].mDescriptors);
+    (*mpFeatureExtractorLeft[Ftype])(im, cv::Mat(), Channels[Ftype].mvKeys.edit(), Channels[Ftype].mDescriptors);
   }
   else {
-    (*mpFeatureExtractorRight[Ftype])(im, cv::Mat(), Channels[Ftype].mvKeysRight, Channels[Ftype].mDescriptorsRight);
+    (*mpFeatureExtractorRight[Ftype])(im, cv::Mat(), Channels[Ftype].mvKeysRight.edit(), Channels[Ftype].mDescriptorsRight);
   }
 }
 
@@ -383,119 +420,55 @@ vector<size_t> Frame::GetFeaturesInArea(const int Ftype, const float &x, const f
   vector<size_t> vIndices;
   vIndices.reserve(Channels[Ftype].N);
 
-  const int nMinCellX = max(0, (int)floor((x - mnMinX - r) * mfGridElementWidthInv));
-  if (nMinCellX >= FRAME_GRID_COLS)
-    return vIndices;
-
-  const int nMaxCellX = min((int)FRAME_GRID_COLS - 1, (int)ceil((x - mnMinX + r) * mfGridElementWidthInv));
-  if (nMaxCellX < 0)
-    return vIndices;
-
-  const int nMinCellY = max(0, (int)floor((y - mnMinY - r) * mfGridElementHeightInv));
-  if (nMinCellY >= FRAME_GRID_ROWS)
-    return vIndices;
-
-  const int nMaxCellY = min((int)FRAME_GRID_ROWS - 1, (int)ceil((y - mnMinY + r) * mfGridElementHeightInv));
-  if (nMaxCellY < 0)
-    return vIndices;
-
-  const bool bCheckLevels = (minLevel > 0) || (maxLevel >= 0);
-
-  for (int ix = nMinCellX; ix <= nMaxCellX; ix++) {
-    for (int iy = nMinCellY; iy <= nMaxCellY; iy++) {
-      const vector<size_t> vCell = Channels[Ftype].mGrid[ix][iy];
-      if (vCell.empty())
-        continue;
-
-      for (size_t j = 0, jend = vCell.size(); j < jend; j++) {
-        const cv::KeyPoint &kpUn = Channels[Ftype].mvKeysUn[vCell[j]];
-        if (bCheckLevels) {
-          if (kpUn.octave < minLevel)
-            continue;
-          if (maxLevel >= 0)
-            if (kpUn.octave > maxLevel)
-              continue;
-        }
-
-        const float distx = kpUn.pt.x - x;
-        const float disty = kpUn.pt.y - y;
-
-        if (fabs(distx) < r && fabs(disty) < r)
-          vIndices.push_back(vCell[j]);
-      }
-    }
-  }
+  Channels[Ftype].mGrid->GetFeaturesInArea(Channels[Ftype].mKeysUnSoA, x, y, r, minLevel, maxLevel, vIndices);
 
   return vIndices;
 }
 
-bool Frame::PosInGrid(const cv::KeyPoint &kp, int &posX, int &posY) {
-  posX = round((kp.pt.x - mnMinX) * mfGridElementWidthInv);
-  posY = round((kp.pt.y - mnMinY) * mfGridElementHeightInv);
-
-  // Keypoint's coordinates are undistorted, which could cause to go out of the image
-  if (posX < 0 || posX >= FRAME_GRID_COLS || posY < 0 || posY >= FRAME_GRID_ROWS)
-    return false;
-
-  return true;
-}
-
 void Frame::ComputeBoW(const int Ftype) {
-  if (Channels[Ftype].mBowVec.empty()) {
+  if (Channels[Ftype].mBowVec.empty() && !Channels[Ftype].mDescriptors.empty()) {
     // vector<cv::Mat> vCurrentDesc = Converter::toDescriptorVector(Channels[Ftype].mDescriptors);
-    mpVocabulary[Ftype]->transform(Channels[Ftype].mDescriptors, Channels[Ftype].mBowVec, Channels[Ftype].mFeatVec, 4);
+    mpVocabulary[Ftype]->transform(Channels[Ftype].mDescriptors, Channels[Ftype].mBowVec.edit(), Channels[Ftype].mFeatVec.edit(), 4);
   }
 }
 
 void Frame::UndistortKeyPoints(const int Ftype) {
   if (mDistCoef.at<float>(0) == 0.0) {
     Channels[Ftype].mvKeysUn = Channels[Ftype].mvKeys;
+    Channels[Ftype].mKeysUnSoA.edit().Assign(Channels[Ftype].mvKeysUn);
     return;
   }
 
-  // Fill matrix with points
-  cv::Mat mat(Channels[Ftype].N, 2, CV_32F);
-  for (int i = 0; i < Channels[Ftype].N; i++) {
-    mat.at<float>(i, 0) = Channels[Ftype].mvKeys[i].pt.x;
-    mat.at<float>(i, 1) = Channels[Ftype].mvKeys[i].pt.y;
-  }
-
-  // Undistort points
-  mat = mat.reshape(2);
-  cv::undistortPoints(mat, mat, mK, mDistCoef, cv::Mat(), mK);
-  mat = mat.reshape(1);
+  // Undistort the coordinate arrays by table lookup
+  const vector<cv::KeyPoint> &vKeys = Channels[Ftype].mvKeys;
+  KeyPointArray &keysUn = Channels[Ftype].mKeysUnSoA.edit();
+  keysUn.Assign(vKeys);
+  mUndistortionMap.Undistort(keysUn.x.data(), keysUn.y.data(), Channels[Ftype].N);
 
   // Fill undistorted keypoint vector
-  Channels[Ftype].mvKeysUn.resize(Channels[Ftype].N);
+  vector<cv::KeyPoint> &vKeysUn = Channels[Ftype].mvKeysUn.edit();
+  vKeysUn = vKeys;
   for (int i = 0; i < Channels[Ftype].N; i++) {
-    cv::KeyPoint kp = Channels[Ftype].mvKeys[i];
-    kp.pt.x = mat.at<float>(i, 0);
-    kp.pt.y = mat.at<float>(i, 1);
-    Channels[Ftype].mvKeysUn[i] = kp;
+    vKeysUn[i].pt.x = keysUn.x[i];
+    vKeysUn[i].pt.y = keysUn.y[i];
   }
 }
 
 void Frame::ComputeImageBounds(const cv::Mat &imLeft) {
   if (mDistCoef.at<float>(0) != 0.0) {
-    cv::Mat mat(4, 2, CV_32F);
-    mat.at<float>(0, 0) = 0.0;
-    mat.at<float>(0, 1) = 0.0;
-    mat.at<float>(1, 0) = imLeft.cols;
-    mat.at<float>(1, 1) = 0.0;
-    mat.at<float>(2, 0) = 0.0;
-    mat.at<float>(2, 1) = imLeft.rows;
-    mat.at<float>(3, 0) = imLeft.cols;
-    mat.at<float>(3, 1) = imLeft.rows;
-
-    // Undistort corners
-    mat = mat.reshape(2);
-    cv::undistortPoints(mat, mat, mK, mDistCoef, cv::Mat(), mK);
-    mat = mat.reshape(1);
-
-    mnMinX = min(mat.at<float>(0, 0), mat.at<float>(2, 0));
-    mnMaxX = max(mat.at<float>(1, 0), mat.at<float>(3, 0));
-    mnMinY = min(mat.at<float>(0, 1), mat.at<float>(1, 1));
-    mnMaxY = max(mat.at<float>(2, 1), mat.at<float>(3, 1));
+    // Calibration is fixed from here on: tabulate the undistortion once
+    mUndistortionMap.Create(mK, mDistCoef, imLeft.cols, imLeft.rows);
+
+    // Undistort corners (table nodes, exact)
+    const cv::Point2f tl = mUndistortionMap.Undistort(0.0f, 0.0f);
+    const cv::Point2f tr = mUndistortionMap.Undistort(imLeft.cols, 0.0f);
+    const cv::Point2f bl = mUndistortionMap.Undistort(0.0f, imLeft.rows);
+    const cv::Point2f br = mUndistortionMap.Undistort(imLeft.cols, imLeft.rows);
+
+    mnMinX = min(tl.x, bl.x);
+    mnMaxX = max(tr.x, br.x);
+    mnMinY = min(tl.y, tr.y);
+    mnMaxY = max(bl.y, br.y);
 
   } else {
     mnMinX = 0.0f;
@@ -506,29 +479,53 @@ void Frame::ComputeImageBounds(const cv::Mat &imLeft) {
 }
 
 void Frame::ComputeStereoMatches(const int Ftype) {
-  Channels[Ftype].mvuRight = vector<float>(Channels[Ftype].N, -1.0f);
-  Channels[Ftype].mvDepth = vector<float>(Channels[Ftype].N, -1.0f);
+  FeaturePoint &channel = Channels[Ftype];
+  const int N = channel.N;
+  channel.mvuRight = vector<float>(N, -1.0f);
+  channel.mvDepth = vector<float>(N, -1.0f);
 
+  const float thHigh = Associater::mvTH_HIGH[Ftype];
   const float thOrbDist = (Associater::mvTH_HIGH[Ftype] + Associater::mvTH_LOW[Ftype]) / 2;
 
-  const int nRows = mpFeatureExtractorLeft[Ftype]->mvImagePyramid[0].rows;
-
-  // Assign keypoints to row table
-  vector<vector<size_t>> vRowIndices(nRows, vector<size_t>());
-  for (int i = 0; i < nRows; i++)
-    vRowIndices[i].reserve(200);
-
-  const int Nr =  Channels[Ftype].mvKeysRight.size();
-
+  const vector<cv::Mat> &vPyramidLeft = mpFeatureExtractorLeft[Ftype]->mvImagePyramid;
+  const vector<cv::Mat> &vPyramidRight = mpFeatureExtractorRight[Ftype]->mvImagePyramid;
+  const int nRows = vPyramidLeft[0].rows;
+
+  const vector<cv::KeyPoint> &vKeys = channel.mvKeys;
+  const vector<cv::KeyPoint> &vKeysRight = channel.mvKeysRight;
+  const cv::Mat &descriptors = channel.mDescriptors;
+  const cv::Mat &descriptorsRight = channel.mDescriptorsRight;
+  const int Nr = vKeysRight.size();
+  const DescriptorMetric descriptorDistance(descriptors);
+
+  // Right keypoints as arrays, read by the band scan
+  vector<float> vuR(Nr);
+  vector<int> vOctaveR(Nr);
+  vector<int> vMinRow(Nr), vMaxRow(Nr);
   for (int iR = 0; iR < Nr; iR++) {
-    const cv::KeyPoint &kp = Channels[Ftype].mvKeysRight[iR];
-    const float &kpY = kp.pt.y;
-    const float r = 2.0f * mvScaleFactors[Channels[Ftype].mvKeysRight[iR].octave];
-    const int maxr = ceil(kpY + r);
-    const int minr = floor(kpY - r);
-
-    for (int yi = minr; yi <= maxr; yi++)
-      vRowIndices[yi].push_back(iR);
+    const cv::KeyPoint &kp = vKeysRight[iR];
+    const float r = 2.0f * mvScaleFactors[kp.octave];
+    vuR[iR] = kp.pt.x;
+    vOctaveR[iR] = kp.octave;
+    vMinRow[iR] = max((int)floor(kp.pt.y - r), 0);
+    vMaxRow[iR] = min((int)ceil(kp.pt.y + r), nRows - 1);
+  }
+
+  // Row table in compressed sparse row form: the right keypoints whose band covers row y are
+  // vRowIndices[vRowOffsets[y], vRowOffsets[y + 1]), in increasing index order
+  vector<int> vRowOffsets(nRows + 1, 0);
+  for (int iR = 0; iR < Nr; iR++)
+    for (int yi = vMinRow[iR]; yi <= vMaxRow[iR]; yi++)
+      vRowOffsets[yi + 1]++;
+  for (int yi = 0; yi < nRows; yi++)
+    vRowOffsets[yi + 1] += vRowOffsets[yi];
+
+  vector<int> vRowIndices(vRowOffsets[nRows]);
+  {
+    vector<int> vNext(vRowOffsets.begin(), vRowOffsets.end() - 1);
+    for (int iR = 0; iR < Nr; iR++)
+      for (int yi = vMinRow[iR]; yi <= vMaxRow[iR]; yi++)
+        vRowIndices[vNext[yi]++] = iR;
   }
 
   // Set limits for search
@@ -536,112 +533,123 @@ void Frame::ComputeStereoMatches(const int Ftype) {
   const float minD = 0;
   const float maxD = mbf / minZ;
 
-  // For each left keypoint search a match in the right image
-  vector<pair<int, int>> vDistIdx;
-  vDistIdx.reserve(Channels[Ftype].N);
-
-  for (int iL = 0; iL < Channels[Ftype].N; iL++) {
-    const cv::KeyPoint &kpL = Channels[Ftype].mvKeys[iL];
-    const int &levelL = kpL.octave;
-    const float &vL = kpL.pt.y;
-    const float &uL = kpL.pt.x;
-
-    const vector<size_t> &vCandidates = vRowIndices[vL];
+  // Results per left keypoint, written by exactly one block each
+  float *pDepth = channel.mvDepth.edit().data();
+  float *puRight = channel.mvuRight.edit().data();
+  vector<int> vBestSAD(N, -1);
 
-    if (vCandidates.empty())
-      continue;
+  // sliding window half size and search range of the correlation
+  const int w = 5;
+  const int L = 5;
 
-    const float minU = uL - maxD;
-    const float maxU = uL - minD;
+  // For each left keypoint search a match in the right image. Keypoints are independent, blocks run in parallel.
+  auto matchBlock = [&](const cv::Range &range) {
+    vector<size_t> vCandidates;
+    vector<float> vDists;
 
-    if (maxU < 0)
-      continue;
+    for (int iL = range.start; iL < range.end; iL++) {
+      const cv::KeyPoint &kpL = vKeys[iL];
+      const int levelL = kpL.octave;
+      const float vL = kpL.pt.y;
+      const float uL = kpL.pt.x;
 
-    float bestDist = Associater::mvTH_HIGH[Ftype];
-    size_t bestIdxR = 0;
+      const int row = (int)vL;
+      if (row < 0 || row >= nRows)
+        continue;
 
-    const cv::Mat &dL = Channels[Ftype].mDescriptors.row(iL);
+      const int begin = vRowOffsets[row];
+      const int end = vRowOffsets[row + 1];
+      if (begin == end)
+        continue;
 
-    // Compare descriptor to right keypoints
-    for (size_t iC = 0; iC < vCandidates.size(); iC++) {
-      const size_t iR = vCandidates[iC];
-      const cv::KeyPoint &kpR = Channels[Ftype].mvKeysRight[iR];
+      const float minU = uL - maxD;
+      const float maxU = uL - minD;
 
-      if (kpR.octave < levelL - 1 || kpR.octave > levelL + 1)
+      if (maxU < 0)
         continue;
 
-      const float &uR = kpR.pt.x;
-
-      if (uR >= minU && uR <= maxU) {
-        const cv::Mat &dR = Channels[Ftype].mDescriptorsRight.row(iR);
-        const float dist = Associater::DescriptorDistance(dL, dR);
+      // Candidates of the band within the scale and disparity limits
+      vCandidates.clear();
+      for (int j = begin; j < end; j++) {
+        const int iR = vRowIndices[j];
+        if (vOctaveR[iR] < levelL - 1 || vOctaveR[iR] > levelL + 1)
+          continue;
+        if (vuR[iR] >= minU && vuR[iR] <= maxU)
+          vCandidates.push_back(iR);
+      }
+      if (vCandidates.empty())
+        continue;
 
-        if (dist < bestDist) {
-          bestDist = dist;
-          bestIdxR = iR;
+      // Compare descriptor to right keypoints, all candidates at once
+      const int nCandidates = vCandidates.size();
+      vDists.resize(nCandidates);
+      descriptorDistance.Batch(descriptors.ptr(iL), descriptorsRight, vCandidates.data(), nCandidates, vDists.data());
+
+      float bestDist = thHigh;
+      int bestIdxR = 0;
+      for (int k = 0; k < nCandidates; k++) {
+        if (vDists[k] < bestDist) {
+          bestDist = vDists[k];
+          bestIdxR = vCandidates[k];
         }
       }
-    }
 
-    // Subpixel match by correlation
-    if (bestDist < thOrbDist) {
+      // Subpixel match by correlation
+      if (bestDist >= thOrbDist)
+        continue;
+
       // coordinates in image pyramid at keypoint scale
-      const float uR0 = Channels[Ftype].mvKeysRight[bestIdxR].pt.x;
-      const float scaleFactor = mvInvScaleFactors[kpL.octave];
-      const float scaleduL = round(kpL.pt.x * scaleFactor);
-      const float scaledvL = round(kpL.pt.y * scaleFactor);
-      const float scaleduR0 = round(uR0 * scaleFactor);
-
-      // sliding window search
-      const int w = 5;
-
-      // Range protection
-	  const cv::Mat& pyrImgL = mpFeatureExtractorLeft[Ftype]->mvImagePyramid[kpL.octave];
-      const cv::Mat& pyrImgR = mpFeatureExtractorRight[Ftype]->mvImagePyramid[kpL.octave];
-	  if (scaledvL - w < 0 || scaledvL + w + 1 > pyrImgL.rows || scaleduL - w < 0 || scaleduL + w + 1 > pyrImgL.cols)
+      const float uR0 = vuR[bestIdxR];
+      const float scaleFactor = mvInvScaleFactors[levelL];
+      const int scaleduL = round(kpL.pt.x * scaleFactor);
+      const int scaledvL = round(kpL.pt.y * scaleFactor);
+      const int scaleduR0 = round(uR0 * scaleFactor);
+
+      // Range protection: the left window and every right window of the search must be inside the images
+      const cv::Mat &pyrImgL = vPyramidLeft[levelL];
+      const cv::Mat &pyrImgR = vPyramidRight[levelL];
+      if (scaledvL - w < 0 || scaledvL + w + 1 > pyrImgL.rows || scaleduL - w < 0 || scaleduL + w + 1 > pyrImgL.cols)
+        continue;
+      if (scaledvL + w + 1 > pyrImgR.rows || scaleduR0 - L - w < 0 || scaleduR0 + L + w + 1 > pyrImgR.cols)
         continue;
 
-      cv::Mat IL = mpFeatureExtractorLeft[Ftype]->mvImagePyramid[kpL.octave].rowRange(scaledvL - w, scaledvL + w + 1).colRange(scaleduL - w, scaleduL + w + 1);
-      IL.convertTo(IL, CV_32F);
-      IL = IL - IL.at<float>(w, w) * cv::Mat::ones(IL.rows, IL.cols, CV_32F);
+      // Left window relative to its center
+      int IL[2 * w + 1][2 * w + 1];
+      const int centerL = pyrImgL.ptr<uchar>(scaledvL)[scaleduL];
+      for (int r = 0; r < 2 * w + 1; r++) {
+        const uchar *pL = pyrImgL.ptr<uchar>(scaledvL - w + r) + scaleduL - w;
+        for (int c = 0; c < 2 * w + 1; c++)
+          IL[r][c] = pL[c] - centerL;
+      }
 
-      int bestDist = INT_MAX;
+      // SAD of the centered windows over the 2L+1 offsets
+      int vSAD[2 * L + 1];
+      int bestSAD = INT_MAX;
       int bestincR = 0;
-      const int L = 5;
-      vector<float> vDists;
-      vDists.resize(2 * L + 1);
-
-      const float iniu = scaleduR0 + L - w;
-      const float endu = scaleduR0 + L + w + 1;
-      if (iniu < 0 || endu >= mpFeatureExtractorRight[Ftype]->mvImagePyramid[kpL.octave].cols)
-        continue;
-
       for (int incR = -L; incR <= +L; incR++) {
-		// Range protection
-		int u = scaleduR0 + incR;
-        if (scaledvL - w < 0 || scaledvL + w + 1 > pyrImgR.rows || u - w < 0 || u + w + 1 > pyrImgR.cols)
-          continue;
-
-        cv::Mat IR = mpFeatureExtractorRight[Ftype]->mvImagePyramid[kpL.octave].rowRange(scaledvL - w, scaledvL + w + 1).colRange(scaleduR0 + incR - w, scaleduR0 + incR + w + 1);
-        IR.convertTo(IR, CV_32F);
-        IR = IR - IR.at<float>(w, w) * cv::Mat::ones(IR.rows, IR.cols, CV_32F);
+        const int u = scaleduR0 + incR;
+        const int centerR = pyrImgR.ptr<uchar>(scaledvL)[u];
+        int sad = 0;
+        for (int r = 0; r < 2 * w + 1; r++) {
+          const uchar *pR = pyrImgR.ptr<uchar>(scaledvL - w + r) + u - w;
+          for (int c = 0; c < 2 * w + 1; c++)
+            sad += abs(IL[r][c] - (pR[c] - centerR));
+        }
 
-        float dist = cv::norm(IL, IR, cv::NORM_L1);
-        if (dist < bestDist) {
-          bestDist = dist;
+        vSAD[L + incR] = sad;
+        if (sad < bestSAD) {
+          bestSAD = sad;
           bestincR = incR;
         }
-
-        vDists[L + incR] = dist;
       }
 
       if (bestincR == -L || bestincR == L)
         continue;
 
       // Sub-pixel match (Parabola fitting)
-      const float dist1 = vDists[L + bestincR - 1];
-      const float dist2 = vDists[L + bestincR];
-      const float dist3 = vDists[L + bestincR + 1];
+      const float dist1 = vSAD[L + bestincR - 1];
+      const float dist2 = vSAD[L + bestincR];
+      const float dist3 = vSAD[L + bestincR + 1];
 
       const float deltaR = (dist1 - dist3) / (2.0f * (dist1 + dist3 - 2.0f * dist2));
 
@@ -649,7 +657,7 @@ void Frame::ComputeStereoMatches(const int Ftype) {
         continue;
 
       // Re-scaled coordinate
-      float bestuR = mvScaleFactors[kpL.octave] * ((float)scaleduR0 + (float)bestincR + deltaR);
+      float bestuR = mvScaleFactors[levelL] * ((float)scaleduR0 + (float)bestincR + deltaR);
 
       float disparity = (uL - bestuR);
 
@@ -658,12 +666,23 @@ void Frame::ComputeStereoMatches(const int Ftype) {
           disparity = 0.01;
           bestuR = uL - 0.01;
         }
-        Channels[Ftype].mvDepth[iL] = mbf / disparity;
-        Channels[Ftype].mvuRight[iL] = bestuR;
-        vDistIdx.push_back(pair<int, int>(bestDist, iL));
+        pDepth[iL] = mbf / disparity;
+        puRight[iL] = bestuR;
+        vBestSAD[iL] = bestSAD;
       }
     }
-  }
+  };
+  cv::parallel_for_(cv::Range(0, N), matchBlock, max(1.0, N / 64.0));
+
+  // Collected in keypoint order, so the outlier rejection does not depend on the scheduling
+  vector<pair<int, int>> vDistIdx;
+  vDistIdx.reserve(N);
+  for (int iL = 0; iL < N; iL++)
+    if (vBestSAD[iL] >= 0)
+      vDistIdx.push_back(pair<int, int>(vBestSAD[iL], iL));
+
+  if (vDistIdx.empty())
+    return;
 
   sort(vDistIdx.begin(), vDistIdx.end());
   const float median = vDistIdx[vDistIdx.size() / 2].first;
@@ -673,8 +692,8 @@ void Frame::ComputeStereoMatches(const int Ftype) {
     if (vDistIdx[i].first < thDist)
       break;
     else {
-      Channels[Ftype].mvuRight[vDistIdx[i].second] = -1;
-      Channels[Ftype].mvDepth[vDistIdx[i].second] = -1;
+      puRight[vDistIdx[i].second] = -1;
+      pDepth[vDistIdx[i].second] = -1;
     }
   }
 }
@@ -694,8 +713,8 @@ void Frame::ComputeStereoFromRGBD(const cv::Mat &imDepth, const int Ftype) {
 
     // if(d>0)
     if (d > 0.1f && d < 20.f) {
-      Channels[Ftype].mvDepth[i] = d;
-      Channels[Ftype].mvuRight[i] = kpU.pt.x - mbf / d;
+      Channels[Ftype].mvDepth.edit()[i] = d;
+      Channels[Ftype].mvuRight.edit()[i] = kpU.pt.x - mbf / d;
     }
   }
 }
@@ -749,17 +768,10 @@ void Frame::ComputeFeaturesRGBD(const int Ftype, const cv::Mat &imGray, const cv
 
   
   AssignFeaturesToGrid(Ftype);
-  //AssignFeaturesToGrid(Channels[Ftype].N, Channels[Ftype].mvKeysUn, Channels[Ftype].mGrid);
   // cout << "AssignFeaturesToGrid" << Ftype << endl;
 }
 
-void Frame::ComputeFeaturesStereo(const int Ftype, const cv::Mat &imLeft, const cv::Mat &imRight) {
-  // Feature extraction
-  thread threadLeft(&Frame::ExtractFeatures, this, Ftype, 0, imLeft);
-  thread threadRight(&Frame::ExtractFeatures, this, Ftype, 1, imRight);
-  threadLeft.join();
-  threadRight.join();
-
+void Frame::ComputeFeaturesStereo(const int Ftype) {
   Channels[Ftype].N = Channels[Ftype].mvKeys.size();
   
   if (Channels[Ftype].mvKeys.empty())
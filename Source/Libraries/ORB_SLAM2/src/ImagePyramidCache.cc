@@ -0,0 +1,75 @@
+#include "ImagePyramidCache.h"
+#include <opencv2/imgproc/imgproc.hpp>
+
+using namespace ::std;
+
+namespace ORB_SLAM2 {
+
+ImagePyramidCache::ImagePyramidCache() : mnGeneration(0) {}
+
+void ImagePyramidCache::SetImage(const cv::Mat &image) {
+  unique_lock<mutex> lock(mMutex);
+  mImage = image;
+  mnGeneration++;
+}
+
+bool ImagePyramidCache::Holds(const cv::Mat &image) {
+  unique_lock<mutex> lock(mMutex);
+  return !mImage.empty() && image.data == mImage.data && image.size() == mImage.size() &&
+         image.step == mImage.step && image.type() == mImage.type();
+}
+
+const vector<cv::Mat> &ImagePyramidCache::Get(const double scaleFactor, const int nlevels, const int border,
+                                              const vector<float> &vInvScaleFactor) {
+  Entry *pEntry;
+  cv::Mat image;
+  unsigned long nGeneration;
+  {
+    unique_lock<mutex> lock(mMutex);
+    unique_ptr<Entry> &entry = mEntries[make_tuple(scaleFactor, nlevels, border)];
+    if (!entry)
+      entry.reset(new Entry());
+    pEntry = entry.get();
+    image = mImage;
+    nGeneration = mnGeneration;
+  }
+
+  // Channels asking for the same pyramid wait here for the first one to build it
+  unique_lock<mutex> lock(pEntry->mutex);
+  if (pEntry->nGeneration != nGeneration) {
+    Build(image, vInvScaleFactor, border, pEntry->vBuffers, pEntry->vLevels);
+    pEntry->nGeneration = nGeneration;
+  }
+
+  return pEntry->vLevels;
+}
+
+void ImagePyramidCache::Build(const cv::Mat &image, const vector<float> &vInvScaleFactor, const int border,
+                              vector<cv::Mat> &vBuffers, vector<cv::Mat> &vLevels) {
+  const int nlevels = vInvScaleFactor.size();
+  vBuffers.resize(nlevels);
+  vLevels.resize(nlevels);
+
+  for (int level = 0; level < nlevels; ++level) {
+    float scale = vInvScaleFactor[level];
+    cv::Size sz(cvRound((float)image.cols * scale), cvRound((float)image.rows * scale));
+    cv::Size wholeSize(sz.width + border * 2, sz.height + border * 2);
+
+    // No-op when the buffer from the previous frame already has this size
+    cv::Mat &temp = vBuffers[level];
+    temp.create(wholeSize, image.type());
+    vLevels[level] = temp(cv::Rect(border, border, sz.width, sz.height));
+
+    // Compute the resized image
+    if (level != 0) {
+      cv::resize(vLevels[level - 1], vLevels[level], sz, 0, 0, cv::INTER_LINEAR);
+
+      cv::copyMakeBorder(vLevels[level], temp, border, border, border, border,
+                         cv::BORDER_REFLECT_101 + cv::BORDER_ISOLATED);
+    } else {
+      cv::copyMakeBorder(image, temp, border, border, border, border, cv::BORDER_REFLECT_101);
+    }
+  }
+}
+
+} // namespace ORB_SLAM2
@@ -32,10 +32,6 @@ long unsigned int KeyFrame::nNextId = 0;
 KeyFrame::KeyFrame(Frame &F, Map *pMap, vector<KeyFrameDatabase *> pKFDB, int Ntype)
     : mnFrameId(F.mnId), 
       mTimeStamp(F.mTimeStamp), 
-      mnGridCols(FRAME_GRID_COLS),
-      mnGridRows(FRAME_GRID_ROWS),
-      mfGridElementWidthInv(F.mfGridElementWidthInv),
-      mfGridElementHeightInv(F.mfGridElementHeightInv),
       mnTrackReferenceForFrame(0), 
       mnFuseTargetForKF(0),
       mnBALocalForKF(0),
@@ -81,6 +77,7 @@ KeyFrame::KeyFrame(Frame &F, Map *pMap, vector<KeyFrameDatabase *> pKFDB, int Nt
   mnRelocWords.resize(Ntype);
   mRelocScore.resize(Ntype);
   Channels.resize(Ntype);
+  mvpDescriptorIndex.resize(Ntype);
 
   // Initlizer for Reloc
   for (int Ftype = 0; Ftype < Ntype; Ftype++) {
@@ -106,11 +103,31 @@ void KeyFrame::ComputeBoW(const int Ftype) {
   if (Channels[Ftype].mBowVec.empty() || Channels[Ftype].mFeatVec.empty()) {
     mpVocabulary[Ftype]->transform (
         Channels[Ftype].mDescriptors,
-        Channels[Ftype].mBowVec,
-        Channels[Ftype].mFeatVec, 4);
+        Channels[Ftype].mBowVec.edit(),
+        Channels[Ftype].mFeatVec.edit(), 4);
   }
 }
 
+std::shared_ptr<const DescriptorIndex> KeyFrame::GetDescriptorIndex(const int Ftype) {
+  {
+    unique_lock<mutex> lock(mMutexDescriptorIndex);
+    if (mvpDescriptorIndex[Ftype])
+      return mvpDescriptorIndex[Ftype];
+  }
+  if (isBad())
+    return std::shared_ptr<const DescriptorIndex>();
+
+  // Build outside the lock, a concurrent build of the same channel only wastes time
+  std::shared_ptr<const DescriptorIndex> pIndex = std::make_shared<DescriptorIndex>(Channels[Ftype].mDescriptors);
+
+  unique_lock<mutex> lock(mMutexDescriptorIndex);
+  if (mvpDescriptorIndex[Ftype])
+    return mvpDescriptorIndex[Ftype];
+  if (!isBad())
+    mvpDescriptorIndex[Ftype] = pIndex;
+  return pIndex;
+}
+
 void KeyFrame::SetPose(const cv::Mat &Tcw_) {
   unique_lock<mutex> lock(mMutexPose);
   Tcw_.copyTo(Tcw);
@@ -556,6 +573,13 @@ void KeyFrame::SetBadFlag() {
   mpMap->EraseKeyFrame(this);
   for (int Ftype = 0; Ftype < Ntype; Ftype++)
     mpKeyFrameDB[Ftype]->erase(this, Ftype);
+
+  // Searches still holding an index keep it alive until they finish
+  {
+    unique_lock<mutex> lock(mMutexDescriptorIndex);
+    for (int Ftype = 0; Ftype < Ntype; Ftype++)
+      mvpDescriptorIndex[Ftype].reset();
+  }
 }
 
 bool KeyFrame::isBad() {
@@ -581,35 +605,7 @@ std::vector<std::size_t> KeyFrame::GetFeaturesInArea(const float &x, const float
   std::vector<std::size_t> vIndices;
   vIndices.reserve(Channels[Ftype].N);
 
-  const int nMinCellX = max(0, (int)floor((x - mnMinX - r) * mfGridElementWidthInv));
-  if (nMinCellX >= mnGridCols)
-    return vIndices;
-
-  const int nMaxCellX = min((int)mnGridCols - 1, (int)ceil((x - mnMinX + r) * mfGridElementWidthInv));
-  if (nMaxCellX < 0)
-    return vIndices;
-
-  const int nMinCellY = max(0, (int)floor((y - mnMinY - r) * mfGridElementHeightInv));
-  if (nMinCellY >= mnGridRows)
-    return vIndices;
-
-  const int nMaxCellY = min((int)mnGridRows - 1, (int)ceil((y - mnMinY + r) * mfGridElementHeightInv));
-  if (nMaxCellY < 0)
-    return vIndices;
-
-  for (int ix = nMinCellX; ix <= nMaxCellX; ix++) {
-    for (int iy = nMinCellY; iy <= nMaxCellY; iy++) {
-      const std::vector<std::size_t> vCell = Channels[Ftype].mGrid[ix][iy];
-      for (std::size_t j = 0, jend = vCell.size(); j < jend; j++) {
-        const cv::KeyPoint &kpUn = Channels[Ftype].mvKeysUn[vCell[j]];
-        const float distx = kpUn.pt.x - x;
-        const float disty = kpUn.pt.y - y;
-
-        if (fabs(distx) < r && fabs(disty) < r)
-          vIndices.push_back(vCell[j]);
-      }
-    }
-  }
+  Channels[Ftype].mGrid->GetFeaturesInArea(Channels[Ftype].mKeysUnSoA, x, y, r, -1, -1, vIndices);
 
   return vIndices;
 }
@@ -0,0 +1,151 @@
+#include "KeyPointQuadtree.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace ::std;
+
+namespace ORB_SLAM2 {
+
+void KeyPointQuadtree::Build(const vector<cv::KeyPoint> &vKeys, const int minX, const int maxX, const int minY,
+                             const int maxY, const int N) {
+  const int nKeys = vKeys.size();
+  mvNodes.clear();
+  mvActive.clear();
+  mnActive = 0;
+
+  // Compute how many initial nodes
+  const int width = maxX - minX;
+  const int height = maxY - minY;
+  const int nIni = height > 0 ? max(1, (int)round(static_cast<float>(width) / height)) : 1;
+  const float hX = static_cast<float>(width) / nIni;
+
+  // Associate points to the initial nodes (counting sort of the indices)
+  mvBucket.resize(nKeys);
+  mvNext.assign(nIni + 1, 0);
+  for (int i = 0; i < nKeys; i++) {
+    const int b = min(max((int)(vKeys[i].pt.x / hX), 0), nIni - 1);
+    mvBucket[i] = b;
+    mvNext[b + 1]++;
+  }
+  for (int b = 0; b < nIni; b++)
+    mvNext[b + 1] += mvNext[b];
+
+  mvIndices.resize(nKeys);
+  for (int i = 0; i < nKeys; i++)
+    mvIndices[mvNext[mvBucket[i]]++] = i;
+
+  // mvNext[b] is now the end of bucket b
+  for (int b = 0; b < nIni; b++) {
+    const int begin = b == 0 ? 0 : mvNext[b - 1];
+    const int end = mvNext[b];
+    if (begin == end)
+      continue;
+
+    Node ni;
+    ni.begin = begin;
+    ni.end = end;
+    ni.minX = hX * static_cast<float>(b);
+    ni.maxX = hX * static_cast<float>(b + 1);
+    ni.minY = 0;
+    ni.maxY = height;
+    ni.bNoMore = end - begin == 1;
+    ni.bAlive = true;
+    mvActive.push_back(mvNodes.size());
+    mvNodes.push_back(ni);
+  }
+  mnActive = mvActive.size();
+
+  bool bFinish = false;
+  while (!bFinish) {
+    const int prevSize = mnActive;
+
+    // Split every node holding more than one point
+    mvNext.swap(mvActive);
+    mvActive.clear();
+    mvExpand.clear();
+    mnActive = 0;
+    for (const int node : mvNext) {
+      if (mvNodes[node].bNoMore) {
+        mvActive.push_back(node);
+        mnActive++;
+      } else
+        Divide(vKeys, node, mvExpand);
+    }
+
+    // Finish if there are more nodes than required features or all nodes contain just one point
+    if (mnActive >= N || mnActive == prevSize) {
+      bFinish = true;
+    } else if (mnActive + (int)mvExpand.size() * 3 > N) {
+      // A full pass would overshoot: split the most populated nodes first
+      while (!bFinish) {
+        const int prevSizeExpand = mnActive;
+
+        mvPrevExpand.swap(mvExpand);
+        mvExpand.clear();
+        sort(mvPrevExpand.begin(), mvPrevExpand.end());
+
+        for (int j = mvPrevExpand.size() - 1; j >= 0; j--) {
+          const int node = mvPrevExpand[j].second;
+          Divide(vKeys, node, mvExpand);
+          mvNodes[node].bAlive = false;
+          mnActive--;
+
+          if (mnActive >= N)
+            break;
+        }
+
+        if (mnActive >= N || mnActive == prevSizeExpand)
+          bFinish = true;
+      }
+    }
+  }
+}
+
+void KeyPointQuadtree::Divide(const vector<cv::KeyPoint> &vKeys, const int node, vector<pair<int, int>> &vExpand) {
+  // mvNodes grows below, work on a copy
+  const Node n = mvNodes[node];
+  const int midX = n.minX + (int)ceil(static_cast<float>(n.maxX - n.minX) / 2);
+  const int midY = n.minY + (int)ceil(static_cast<float>(n.maxY - n.minY) / 2);
+
+  // Partition the node range into the four quadrants: [UL | BL | UR | BR]
+  int *base = mvIndices.data();
+  int *first = base + n.begin;
+  int *last = base + n.end;
+  int *splitX = partition(first, last, [&](const int i) { return vKeys[i].pt.x < midX; });
+  int *splitL = partition(first, splitX, [&](const int i) { return vKeys[i].pt.y < midY; });
+  int *splitR = partition(splitX, last, [&](const int i) { return vKeys[i].pt.y < midY; });
+
+  // Children in the order UL, UR, BL, BR
+  const int vBegin[4] = {n.begin, (int)(splitX - base), (int)(splitL - base), (int)(splitR - base)};
+  const int vEnd[4] = {(int)(splitL - base), (int)(splitR - base), (int)(splitX - base), n.end};
+  const int vMinX[4] = {n.minX, midX, n.minX, midX};
+  const int vMaxX[4] = {midX, n.maxX, midX, n.maxX};
+  const int vMinY[4] = {n.minY, n.minY, midY, midY};
+  const int vMaxY[4] = {midY, midY, n.maxY, n.maxY};
+
+  for (int c = 0; c < 4; c++) {
+    const int nKeys = vEnd[c] - vBegin[c];
+    if (nKeys == 0)
+      continue;
+
+    Node child;
+    child.begin = vBegin[c];
+    child.end = vEnd[c];
+    child.minX = vMinX[c];
+    child.maxX = vMaxX[c];
+    child.minY = vMinY[c];
+    child.maxY = vMaxY[c];
+    child.bNoMore = nKeys == 1;
+    child.bAlive = true;
+
+    const int id = mvNodes.size();
+    mvNodes.push_back(child);
+    mvActive.push_back(id);
+    mnActive++;
+    if (nKeys > 1)
+      vExpand.push_back(make_pair(nKeys, id));
+  }
+}
+
+} // namespace ORB_SLAM2
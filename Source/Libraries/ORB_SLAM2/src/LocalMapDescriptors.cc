@@ -0,0 +1,75 @@
+#include "LocalMapDescriptors.h"
+#include "MapPoint.h"
+
+#include <climits>
+
+using namespace ::std;
+
+namespace ORB_SLAM2 {
+
+const unsigned int LocalMapDescriptors::INVALID_VERSION = UINT_MAX;
+
+void LocalMapDescriptors::Update(const vector<MapPoint *> &vpLocalMapPoints, const int Ntype) {
+  mvDescriptors.resize(Ntype);
+  mvvpMapPoints.resize(Ntype);
+  mvvVersions.resize(Ntype);
+
+  vector<vector<MapPoint *>> vvpMapPoints(Ntype);
+  for (MapPoint *pMP : vpLocalMapPoints) {
+    const int Ftype = pMP->GetFeatureType();
+    if (Ftype >= 0 && Ftype < Ntype)
+      vvpMapPoints[Ftype].push_back(pMP);
+  }
+
+  for (int Ftype = 0; Ftype < Ntype; Ftype++) {
+    // Same points in the same order (most frames between two keyframes): keep the rows
+    const bool bSameRows = vvpMapPoints[Ftype] == mvvpMapPoints[Ftype];
+    if (!bSameRows) {
+      mvvpMapPoints[Ftype].swap(vvpMapPoints[Ftype]);
+      mvvVersions[Ftype].assign(mvvpMapPoints[Ftype].size(), INVALID_VERSION);
+    }
+
+    const vector<MapPoint *> &vpMapPoints = mvvpMapPoints[Ftype];
+    cv::Mat &descriptors = mvDescriptors[Ftype];
+    const int nRows = vpMapPoints.size();
+    for (int row = 0; row < nRows; row++) {
+      MapPoint *pMP = vpMapPoints[row];
+      pMP->mnTrackDescriptorRow = row;
+
+      // Read the version first: a descriptor changed meanwhile is copied again on the next update
+      const unsigned int version = pMP->GetDescriptorVersion();
+      if (bSameRows && version == mvvVersions[Ftype][row])
+        continue;
+
+      const cv::Mat descriptor = pMP->GetDescriptor();
+      if (descriptor.empty()) {
+        mvvVersions[Ftype][row] = INVALID_VERSION;
+        continue;
+      }
+
+      if (descriptors.rows != nRows || descriptors.cols != descriptor.cols || descriptors.type() != descriptor.type()) {
+        descriptors.create(nRows, descriptor.cols, descriptor.type());
+        fill(mvvVersions[Ftype].begin(), mvvVersions[Ftype].end(), INVALID_VERSION);
+      }
+
+      descriptor.copyTo(descriptors.row(row));
+      mvvVersions[Ftype][row] = version;
+    }
+  }
+}
+
+const uchar *LocalMapDescriptors::Get(MapPoint *pMP) const {
+  const int Ftype = pMP->GetFeatureType();
+  if (Ftype < 0 || Ftype >= (int)mvvpMapPoints.size())
+    return NULL;
+
+  const int row = pMP->mnTrackDescriptorRow;
+  if (row < 0 || row >= (int)mvvpMapPoints[Ftype].size() || mvvpMapPoints[Ftype][row] != pMP)
+    return NULL;
+  if (mvvVersions[Ftype][row] == INVALID_VERSION)
+    return NULL;
+
+  return mvDescriptors[Ftype].ptr(row);
+}
+
+} // namespace ORB_SLAM2
@@ -0,0 +1,266 @@
+#include "LocalMapSnapshot.h"
+#include "Frame.h"
+#include "MapPoint.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define LOCAL_MAP_SNAPSHOT_X86
+#include <immintrin.h>
+#endif
+
+using namespace ::std;
+
+namespace ORB_SLAM2 {
+
+namespace {
+
+// Pose, calibration and image bounds of the frame, as plain floats
+struct CullParams {
+  float R[9];
+  float t[3];
+  float Ow[3];
+  float fx, fy, cx, cy;
+  float minX, maxX, minY, maxY;
+  float viewingCosLimit;
+};
+
+struct CullInput {
+  const float *X, *Y, *Z;
+  const float *Nx, *Ny, *Nz;
+  const float *MinDistance, *MaxDistance;
+};
+
+struct CullOutput {
+  float *u, *v, *invz, *dist, *viewCos;
+  unsigned char *visible;
+};
+
+typedef void (*CullKernel)(const CullParams &p, const CullInput &in, const int begin, const int n, const CullOutput &out);
+
+// The tests of Frame::isInFrustum, in the same order of operations
+void CullPortable(const CullParams &p, const CullInput &in, const int begin, const int n, const CullOutput &out) {
+  for (int k = 0; k < n; k++) {
+    const int i = begin + k;
+    const float xc = p.R[0] * in.X[i] + p.R[1] * in.Y[i] + p.R[2] * in.Z[i] + p.t[0];
+    const float yc = p.R[3] * in.X[i] + p.R[4] * in.Y[i] + p.R[5] * in.Z[i] + p.t[1];
+    const float zc = p.R[6] * in.X[i] + p.R[7] * in.Y[i] + p.R[8] * in.Z[i] + p.t[2];
+
+    const float invz = 1.0f / zc;
+    const float u = p.fx * xc * invz + p.cx;
+    const float v = p.fy * yc * invz + p.cy;
+
+    const float dx = in.X[i] - p.Ow[0];
+    const float dy = in.Y[i] - p.Ow[1];
+    const float dz = in.Z[i] - p.Ow[2];
+    const float dist = sqrt(dx * dx + dy * dy + dz * dz);
+    const float viewCos = (dx * in.Nx[i] + dy * in.Ny[i] + dz * in.Nz[i]) / dist;
+
+    out.u[k] = u;
+    out.v[k] = v;
+    out.invz[k] = invz;
+    out.dist[k] = dist;
+    out.viewCos[k] = viewCos;
+    out.visible[k] = zc >= 0.0f && u >= p.minX && u <= p.maxX && v >= p.minY && v <= p.maxY &&
+                     dist >= 0.8f * in.MinDistance[i] && dist <= 1.2f * in.MaxDistance[i] &&
+                     viewCos >= p.viewingCosLimit;
+  }
+}
+
+#ifdef LOCAL_MAP_SNAPSHOT_X86
+__attribute__((target("avx2"))) void CullAVX2(const CullParams &p, const CullInput &in, const int begin, const int n,
+                                              const CullOutput &out) {
+  __m256 vR[9], vt[3], vOw[3];
+  for (int j = 0; j < 9; j++)
+    vR[j] = _mm256_set1_ps(p.R[j]);
+  for (int j = 0; j < 3; j++) {
+    vt[j] = _mm256_set1_ps(p.t[j]);
+    vOw[j] = _mm256_set1_ps(p.Ow[j]);
+  }
+  const __m256 fx = _mm256_set1_ps(p.fx), fy = _mm256_set1_ps(p.fy);
+  const __m256 cx = _mm256_set1_ps(p.cx), cy = _mm256_set1_ps(p.cy);
+  const __m256 minX = _mm256_set1_ps(p.minX), maxX = _mm256_set1_ps(p.maxX);
+  const __m256 minY = _mm256_set1_ps(p.minY), maxY = _mm256_set1_ps(p.maxY);
+  const __m256 cosLimit = _mm256_set1_ps(p.viewingCosLimit);
+  const __m256 one = _mm256_set1_ps(1.0f), zero = _mm256_setzero_ps();
+  const __m256 minScale = _mm256_set1_ps(0.8f), maxScale = _mm256_set1_ps(1.2f);
+
+  int k = 0;
+  for (; k + 8 <= n; k += 8) {
+    const int i = begin + k;
+    const __m256 X = _mm256_loadu_ps(in.X + i), Y = _mm256_loadu_ps(in.Y + i), Z = _mm256_loadu_ps(in.Z + i);
+
+    __m256 vc[3];
+    for (int r = 0; r < 3; r++) {
+      __m256 s = _mm256_mul_ps(vR[3 * r], X);
+      s = _mm256_add_ps(s, _mm256_mul_ps(vR[3 * r + 1], Y));
+      s = _mm256_add_ps(s, _mm256_mul_ps(vR[3 * r + 2], Z));
+      vc[r] = _mm256_add_ps(s, vt[r]);
+    }
+
+    const __m256 invz = _mm256_div_ps(one, vc[2]);
+    const __m256 u = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(fx, vc[0]), invz), cx);
+    const __m256 v = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(fy, vc[1]), invz), cy);
+
+    const __m256 dx = _mm256_sub_ps(X, vOw[0]);
+    const __m256 dy = _mm256_sub_ps(Y, vOw[1]);
+    const __m256 dz = _mm256_sub_ps(Z, vOw[2]);
+    __m256 dist2 = _mm256_mul_ps(dx, dx);
+    dist2 = _mm256_add_ps(dist2, _mm256_mul_ps(dy, dy));
+    dist2 = _mm256_add_ps(dist2, _mm256_mul_ps(dz, dz));
+    const __m256 dist = _mm256_sqrt_ps(dist2);
+    __m256 dot = _mm256_mul_ps(dx, _mm256_loadu_ps(in.Nx + i));
+    dot = _mm256_add_ps(dot, _mm256_mul_ps(dy, _mm256_loadu_ps(in.Ny + i)));
+    dot = _mm256_add_ps(dot, _mm256_mul_ps(dz, _mm256_loadu_ps(in.Nz + i)));
+    const __m256 viewCos = _mm256_div_ps(dot, dist);
+
+    // Ordered comparisons: NaN fails every test, as in the scalar code
+    __m256 ok = _mm256_cmp_ps(vc[2], zero, _CMP_GE_OQ);
+    ok = _mm256_and_ps(ok, _mm256_cmp_ps(u, minX, _CMP_GE_OQ));
+    ok = _mm256_and_ps(ok, _mm256_cmp_ps(u, maxX, _CMP_LE_OQ));
+    ok = _mm256_and_ps(ok, _mm256_cmp_ps(v, minY, _CMP_GE_OQ));
+    ok = _mm256_and_ps(ok, _mm256_cmp_ps(v, maxY, _CMP_LE_OQ));
+    ok = _mm256_and_ps(ok, _mm256_cmp_ps(dist, _mm256_mul_ps(minScale, _mm256_loadu_ps(in.MinDistance + i)), _CMP_GE_OQ));
+    ok = _mm256_and_ps(ok, _mm256_cmp_ps(dist, _mm256_mul_ps(maxScale, _mm256_loadu_ps(in.MaxDistance + i)), _CMP_LE_OQ));
+    ok = _mm256_and_ps(ok, _mm256_cmp_ps(viewCos, cosLimit, _CMP_GE_OQ));
+
+    _mm256_storeu_ps(out.u + k, u);
+    _mm256_storeu_ps(out.v + k, v);
+    _mm256_storeu_ps(out.invz + k, invz);
+    _mm256_storeu_ps(out.dist + k, dist);
+    _mm256_storeu_ps(out.viewCos + k, viewCos);
+    const int mask = _mm256_movemask_ps(ok);
+    for (int j = 0; j < 8; j++)
+      out.visible[k + j] = (mask >> j) & 1;
+  }
+
+  if (k < n) {
+    const CullOutput tail = {out.u + k, out.v + k, out.invz + k, out.dist + k, out.viewCos + k, out.visible + k};
+    CullPortable(p, in, begin + k, n - k, tail);
+  }
+}
+#endif
+
+CullKernel SelectKernel() {
+#ifdef LOCAL_MAP_SNAPSHOT_X86
+  static const bool bAVX2 = []() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") != 0;
+  }();
+  if (bAVX2)
+    return CullAVX2;
+#endif
+  return CullPortable;
+}
+
+// Points per kernel call, the outputs live on the stack
+const int CULL_BLOCK = 256;
+
+} // namespace
+
+void LocalMapSnapshot::Assign(const vector<MapPoint *> &vpMapPoints, const int Ntype) {
+  // Counting sort of the points by channel
+  const int nPoints = vpMapPoints.size();
+  vector<int> vFtype(nPoints);
+  mvOffsets.assign(Ntype + 1, 0);
+  for (int i = 0; i < nPoints; i++) {
+    const int Ftype = vpMapPoints[i]->GetFeatureType();
+    vFtype[i] = Ftype >= 0 && Ftype < Ntype ? Ftype : -1;
+    if (vFtype[i] >= 0)
+      mvOffsets[Ftype + 1]++;
+  }
+  for (int Ftype = 0; Ftype < Ntype; Ftype++)
+    mvOffsets[Ftype + 1] += mvOffsets[Ftype];
+
+  const int N = mvOffsets[Ntype];
+  mvpMapPoints.resize(N);
+  mvX.resize(N);
+  mvY.resize(N);
+  mvZ.resize(N);
+  mvNx.resize(N);
+  mvNy.resize(N);
+  mvNz.resize(N);
+  mvMinDistance.resize(N);
+  mvMaxDistance.resize(N);
+
+  vector<int> vNext(mvOffsets.begin(), mvOffsets.end() - 1);
+  for (int i = 0; i < nPoints; i++) {
+    if (vFtype[i] < 0)
+      continue;
+
+    const int j = vNext[vFtype[i]]++;
+    MapPoint *pMP = vpMapPoints[i];
+    float pos[3], normal[3];
+    pMP->GetGeometry(pos, normal, mvMinDistance[j], mvMaxDistance[j]);
+
+    mvpMapPoints[j] = pMP;
+    mvX[j] = pos[0];
+    mvY[j] = pos[1];
+    mvZ[j] = pos[2];
+    mvNx[j] = normal[0];
+    mvNy[j] = normal[1];
+    mvNz[j] = normal[2];
+  }
+}
+
+void LocalMapSnapshot::Cull(Frame &F, const int Ftype, const float viewingCosLimit, vector<MapPoint *> &vpVisible) const {
+  const int begin = mvOffsets[Ftype];
+  const int end = mvOffsets[Ftype + 1];
+  if (begin == end)
+    return;
+
+  CullParams p;
+  const cv::Mat Ow = F.GetCameraCenter();
+  for (int r = 0; r < 3; r++) {
+    for (int c = 0; c < 3; c++)
+      p.R[3 * r + c] = F.mTcw.at<float>(r, c);
+    p.t[r] = F.mTcw.at<float>(r, 3);
+    p.Ow[r] = Ow.at<float>(r);
+  }
+  p.fx = F.fx;
+  p.fy = F.fy;
+  p.cx = F.cx;
+  p.cy = F.cy;
+  p.minX = F.mnMinX;
+  p.maxX = F.mnMaxX;
+  p.minY = F.mnMinY;
+  p.maxY = F.mnMaxY;
+  p.viewingCosLimit = viewingCosLimit;
+
+  const CullInput in = {mvX.data(), mvY.data(), mvZ.data(), mvNx.data(), mvNy.data(), mvNz.data(),
+                        mvMinDistance.data(), mvMaxDistance.data()};
+  const CullKernel kernel = SelectKernel();
+
+  float vU[CULL_BLOCK], vV[CULL_BLOCK], vInvz[CULL_BLOCK], vDist[CULL_BLOCK], vViewCos[CULL_BLOCK];
+  unsigned char vbVisible[CULL_BLOCK];
+  const CullOutput out = {vU, vV, vInvz, vDist, vViewCos, vbVisible};
+
+  for (int b = begin; b < end; b += CULL_BLOCK) {
+    const int n = min(CULL_BLOCK, end - b);
+    kernel(p, in, b, n, out);
+
+    for (int k = 0; k < n; k++) {
+      MapPoint *pMP = mvpMapPoints[b + k];
+      if (!vbVisible[k]) {
+        pMP->mbTrackInView = false;
+        continue;
+      }
+
+      // Predict scale in the image (MapPoint::PredictScale on the snapshot distances)
+      int nPredictedLevel = ceil(log(mvMaxDistance[b + k] / vDist[k]) / F.mfLogScaleFactor);
+      nPredictedLevel = min(max(nPredictedLevel, 0), F.mnScaleLevels - 1);
+
+      // Data used by the tracking
+      pMP->mbTrackInView = true;
+      pMP->mTrackProjX = vU[k];
+      pMP->mTrackProjXR = vU[k] - F.mbf * vInvz[k];
+      pMP->mTrackProjY = vV[k];
+      pMP->mnTrackScaleLevel = nPredictedLevel;
+      pMP->mTrackViewCos = vViewCos[k];
+      vpVisible.push_back(pMP);
+    }
+  }
+}
+
+} // namespace ORB_SLAM2
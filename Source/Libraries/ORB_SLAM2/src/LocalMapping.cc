@@ -22,6 +22,7 @@
 #include "LoopClosing.h"
 #include "Associater.h"
 #include "Optimizer.h"
+#include "ThreadBudget.h"
 
 #include <mutex>
 
@@ -49,6 +50,7 @@ void LocalMapping::SetLoopCloser(LoopClosing *pLoopCloser) {
 void LocalMapping::SetTracker(Tracking *pTracker) { mpTracker = pTracker; }
 
 void LocalMapping::Run() {
+  ThreadBudget::pinCurrentThread(ThreadBudget::MAPPING);
 
   mbFinished = false;
 
@@ -293,9 +295,11 @@ void LocalMapping::ProcessNewKeyFrameMultiChannels() {
     mlNewKeyFrames.pop_front();
   }
 
-  // Compute Bags of Words structures
-  for (int Ftype = 0; Ftype < Ntype; Ftype++)
+  // Compute Bags of Words structures and the descriptor indices, off the tracking thread
+  for (int Ftype = 0; Ftype < Ntype; Ftype++) {
     mpCurrentKeyFrame->ComputeBoW(Ftype);
+    mpCurrentKeyFrame->GetDescriptorIndex(Ftype);
+  }
   
   for (int Ftype = 0; Ftype < Ntype; Ftype++) {
       
@@ -28,6 +28,8 @@
 
 #include "Associater.h"
 
+#include "ThreadBudget.h"
+
 #include <mutex>
 #include <thread>
 #include <unordered_set>
@@ -68,6 +70,8 @@ void LoopClosing::SetLocalMapper(LocalMapping *pLocalMapper) {
 }
 
 void LoopClosing::Run() {
+  ThreadBudget::pinCurrentThread(ThreadBudget::LOOP_CLOSING);
+
   mbFinished = false;
 
   while (1) {
@@ -778,6 +782,8 @@ void LoopClosing::SearchAndFuse(const KeyFrameAndPose &CorrectedPosesMap, const
 }
 
 void LoopClosing::RunGlobalBundleAdjustmentMultiChannels(unsigned long nLoopKF) {
+  ThreadBudget::pinCurrentThread(ThreadBudget::LOOP_CLOSING);
+
   cout << "Starting Global Bundle Adjustment" << endl;
 
   int idx = mnFullBAIdx;
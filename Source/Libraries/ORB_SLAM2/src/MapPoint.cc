@@ -21,6 +21,7 @@
 #include "MapPoint.h"
 #include "Associater.h"
 #include "CorrelationEdge.h"
+#include "DescriptorMetric.h"
 
 #include <mutex>
 
@@ -37,6 +38,7 @@ MapPoint::MapPoint(const cv::Mat &Pos, KeyFrame *pRefKF, Map *pMap, const int Ft
       nObs(0),
       mnTrackReferenceForFrame(0), 
       mnLastFrameSeen(0), 
+      mnTrackDescriptorRow(-1),
       mnBALocalForKF(0),
       mnFuseCandidateForKF(0), 
       mnLoopPointForKF(0), 
@@ -46,6 +48,7 @@ MapPoint::MapPoint(const cv::Mat &Pos, KeyFrame *pRefKF, Map *pMap, const int Ft
       mpRefKF(pRefKF),
       mnVisible(1), 
       mnFound(1), 
+      mnDescriptorVersion(0),
       mbBad(false),
       mpReplaced(static_cast<MapPoint *>(NULL)), 
       mfMinDistance(0),
@@ -66,6 +69,7 @@ MapPoint::MapPoint(const cv::Mat &Pos, Map *pMap, Frame *pFrame, const int &idxF
       nObs(0),
       mnTrackReferenceForFrame(0), 
       mnLastFrameSeen(0), 
+      mnTrackDescriptorRow(-1),
       mnBALocalForKF(0),
       mnFuseCandidateForKF(0), 
       mnLoopPointForKF(0), 
@@ -75,6 +79,7 @@ MapPoint::MapPoint(const cv::Mat &Pos, Map *pMap, Frame *pFrame, const int &idxF
       mpRefKF(static_cast<KeyFrame *>(NULL)), 
       mnVisible(1), 
       mnFound(1),
+      mnDescriptorVersion(0),
       mbBad(false), 
       mpReplaced(NULL), 
       mpMap(pMap), 
@@ -116,6 +121,16 @@ cv::Mat MapPoint::GetNormal() {
   return mNormalVector.clone();
 }
 
+void MapPoint::GetGeometry(float *pPos, float *pNormal, float &minDistance, float &maxDistance) {
+  unique_lock<mutex> lock(mMutexPos);
+  for (int i = 0; i < 3; i++) {
+    pPos[i] = mWorldPos.at<float>(i);
+    pNormal[i] = mNormalVector.at<float>(i);
+  }
+  minDistance = mfMinDistance;
+  maxDistance = mfMaxDistance;
+}
+
 KeyFrame *MapPoint::GetReferenceKeyFrame() {
   unique_lock<mutex> lock(mMutexFeatures);
   return mpRefKF;
@@ -286,14 +301,17 @@ void MapPoint::ComputeDistinctiveDescriptors() {
   // Compute distances between them
   const std::size_t N = vDescriptors.size();
 
+  const DescriptorMetric descriptorDistance(vDescriptors[0]);
+  std::vector<const uchar *> vpDescriptors(N);
+  for (std::size_t i = 0; i < N; i++)
+    vpDescriptors[i] = vDescriptors[i].data;
+
   float Distances[N][N];
   for (std::size_t i = 0; i < N; i++) {
     Distances[i][i] = 0;
-    for (std::size_t j = i + 1; j < N; j++) {
-      float distij = Associater::DescriptorDistance(vDescriptors[i], vDescriptors[j]);
-      Distances[i][j] = distij;
-      Distances[j][i] = distij;
-    }
+    descriptorDistance.Batch(vpDescriptors[i], vpDescriptors.data() + i + 1, N - i - 1, &Distances[i][i + 1]);
+    for (std::size_t j = i + 1; j < N; j++)
+      Distances[j][i] = Distances[i][j];
   }
 
   // Take the descriptor with least median distance to the rest
@@ -313,6 +331,7 @@ void MapPoint::ComputeDistinctiveDescriptors() {
   {
     unique_lock<mutex> lock(mMutexFeatures);
     mDescriptor = vDescriptors[BestIdx].clone();
+    mnDescriptorVersion.fetch_add(1, std::memory_order_release);
   }
 }
 
@@ -454,4 +473,13 @@ uint32_t MapPoint::GetEdgeCount(MapPoint *pOther) const {
     return (it==mAdjEdges.end()) ? 0 : it->second->counter.load();
 }
 
+std::vector<MapPoint *> MapPoint::GetCorrelatedPoints(const uint32_t th_str) const {
+    std::vector<MapPoint *> vpPoints;
+    std::lock_guard<std::mutex> lk(mMutexEdge);
+    for (const auto &kv : mAdjEdges)
+        if (kv.second->counter.load() >= th_str)
+            vpPoints.push_back(kv.first);
+    return vpPoints;
+}
+
 } // namespace ORB_SLAM2
@@ -62,10 +62,18 @@
 #include "ORBextractor.h"
 #include "FeatureExtractorFactory.h"
 
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 
 #include "Perf.h"
 
+// Vectorized orientation / rBRIEF kernels, selected at runtime when the CPU supports AVX2.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ORB_AVX2_DISPATCH
+#include <immintrin.h>
+#endif
+
 using namespace cv;
 using namespace std;
 
@@ -108,6 +116,74 @@ static float IC_Angle(const Mat &image, Point2f pt, const vector<int> &u_max) {
   return fastAtan2((float)m_01, (float)m_10);
 }
 
+// Setting ORB_DISABLE_SIMD in the environment forces the scalar kernels (useful to compare outputs).
+// The variable is read on every call, so a process can compare both paths (bench_extractors --simd).
+static bool UseAVX2() {
+#ifdef ORB_AVX2_DISPATCH
+  static const bool bAVX2 = __builtin_cpu_supports("avx2");
+  return bAVX2 && getenv("ORB_DISABLE_SIMD") == nullptr;
+#else
+  return false;
+#endif
+}
+
+#ifdef ORB_AVX2_DISPATCH
+// Same integer moments as IC_Angle. Each patch row is read as u = -16..15 and the
+// samples outside the circular patch are masked out, so the result is bit-exact.
+__attribute__((target("avx2")))
+static float IC_AngleAVX2(const Mat &image, Point2f pt, const vector<int> &u_max) {
+  const uchar *center = &image.at<uchar>(cvRound(pt.y), cvRound(pt.x));
+  const int step = (int)image.step1();
+
+  const __m256i uLo = _mm256_setr_epi16(-16, -15, -14, -13, -12, -11, -10, -9, -8, -7, -6, -5, -4, -3, -2, -1);
+  const __m256i uHi = _mm256_setr_epi16(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+  const __m256i absLo = _mm256_abs_epi16(uLo);
+  const __m256i absHi = _mm256_abs_epi16(uHi);
+
+  // Treat the center line differently, v=0
+  __m256i lim = _mm256_set1_epi16(FeatureExtractor::HALF_PATCH_SIZE + 1);
+  __m256i cLo = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(center - 16)));
+  __m256i cHi = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(center)));
+  cLo = _mm256_and_si256(cLo, _mm256_cmpgt_epi16(lim, absLo));
+  cHi = _mm256_and_si256(cHi, _mm256_cmpgt_epi16(lim, absHi));
+  __m256i acc10 = _mm256_add_epi32(_mm256_madd_epi16(cLo, uLo), _mm256_madd_epi16(cHi, uHi));
+  __m256i acc01 = _mm256_setzero_si256();
+
+  for (int v = 1; v <= FeatureExtractor::HALF_PATCH_SIZE; ++v) {
+    const uchar *rowPlus = center + v * step;
+    const uchar *rowMinus = center - v * step;
+    lim = _mm256_set1_epi16(u_max[v] + 1);
+    const __m256i maskLo = _mm256_cmpgt_epi16(lim, absLo);
+    const __m256i maskHi = _mm256_cmpgt_epi16(lim, absHi);
+
+    const __m256i pLo = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(rowPlus - 16)));
+    const __m256i pHi = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(rowPlus)));
+    const __m256i mLo = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(rowMinus - 16)));
+    const __m256i mHi = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(rowMinus)));
+
+    const __m256i sumLo = _mm256_and_si256(_mm256_add_epi16(pLo, mLo), maskLo);
+    const __m256i sumHi = _mm256_and_si256(_mm256_add_epi16(pHi, mHi), maskHi);
+    const __m256i difLo = _mm256_and_si256(_mm256_sub_epi16(pLo, mLo), maskLo);
+    const __m256i difHi = _mm256_and_si256(_mm256_sub_epi16(pHi, mHi), maskHi);
+
+    const __m256i vv = _mm256_set1_epi16(v);
+    acc10 = _mm256_add_epi32(acc10, _mm256_add_epi32(_mm256_madd_epi16(sumLo, uLo), _mm256_madd_epi16(sumHi, uHi)));
+    acc01 = _mm256_add_epi32(acc01, _mm256_add_epi32(_mm256_madd_epi16(difLo, vv), _mm256_madd_epi16(difHi, vv)));
+  }
+
+  alignas(32) int m10[8], m01[8];
+  _mm256_store_si256((__m256i *)m10, acc10);
+  _mm256_store_si256((__m256i *)m01, acc01);
+  int m_10 = 0, m_01 = 0;
+  for (int i = 0; i < 8; i++) {
+    m_10 += m10[i];
+    m_01 += m01[i];
+  }
+
+  return fastAtan2((float)m_01, (float)m_10);
+}
+#endif
+
 const float factorPI = (float)(CV_PI / 180.f);
 static void computeOrbDescriptor(const KeyPoint &kpt, const Mat &img,
                                  const Point *pattern, uchar *desc) {
@@ -154,6 +230,49 @@ static void computeOrbDescriptor(const KeyPoint &kpt, const Mat &img,
 #undef GET_VALUE
 }
 
+#ifdef ORB_AVX2_DISPATCH
+// px/py hold the first points of the 256 pattern pairs followed by the second points.
+// Rotated offsets use the same single precision mul/add and round-to-nearest as
+// GET_VALUE (no FMA), and the 256 comparisons are packed with movemask, so the
+// descriptor is bit-exact with computeOrbDescriptor.
+__attribute__((target("avx2")))
+static void computeOrbDescriptorAVX2(const KeyPoint &kpt, const Mat &img,
+                                     const float *px, const float *py, uchar *desc) {
+  float angle = (float)kpt.angle * factorPI;
+  float a = (float)cos(angle), b = (float)sin(angle);
+
+  const uchar *center = &img.at<uchar>(cvRound(kpt.pt.y), cvRound(kpt.pt.x));
+  const int step = (int)img.step;
+
+  alignas(32) int offsets[512];
+  const __m256 va = _mm256_set1_ps(a);
+  const __m256 vb = _mm256_set1_ps(b);
+  const __m256i vstep = _mm256_set1_epi32(step);
+  for (int k = 0; k < 512; k += 8) {
+    const __m256 x = _mm256_loadu_ps(px + k);
+    const __m256 y = _mm256_loadu_ps(py + k);
+    const __m256i row = _mm256_cvtps_epi32(_mm256_add_ps(_mm256_mul_ps(x, vb), _mm256_mul_ps(y, va)));
+    const __m256i col = _mm256_cvtps_epi32(_mm256_sub_ps(_mm256_mul_ps(x, va), _mm256_mul_ps(y, vb)));
+    _mm256_store_si256((__m256i *)(offsets + k), _mm256_add_epi32(_mm256_mullo_epi32(row, vstep), col));
+  }
+
+  alignas(32) uchar t0[256], t1[256];
+  for (int i = 0; i < 256; i++) {
+    t0[i] = center[offsets[i]];
+    t1[i] = center[offsets[256 + i]];
+  }
+
+  // Bit j of desc[i] is (t0 < t1) of pair 8 * i + j
+  for (int i = 0; i < 8; i++) {
+    const __m256i v0 = _mm256_load_si256((const __m256i *)(t0 + 32 * i));
+    const __m256i v1 = _mm256_load_si256((const __m256i *)(t1 + 32 * i));
+    const __m256i ge = _mm256_cmpeq_epi8(_mm256_max_epu8(v0, v1), v0);
+    const uint32_t bits = ~(uint32_t)_mm256_movemask_epi8(ge);
+    memcpy(desc + 4 * i, &bits, sizeof(bits));
+  }
+}
+#endif
+
 static int bit_pattern_31_[256 * 4] = {
     8,   -3,  9,   5 /*mean (0), correlation (0)*/,
     4,   2,   7,   -12 /*mean (1.12461e-05), correlation (0.0437584)*/,
@@ -457,6 +576,17 @@ ORBextractor::ORBextractor(int _nfeatures, float _scaleFactor, int _nlevels,
 
 static void computeOrientation(const Mat &image, vector<KeyPoint> &keypoints,
                                const vector<int> &umax) {
+#ifdef ORB_AVX2_DISPATCH
+  if (UseAVX2()) {
+    for (vector<KeyPoint>::iterator keypoint = keypoints.begin(),
+                                    keypointEnd = keypoints.end();
+         keypoint != keypointEnd; ++keypoint) {
+      keypoint->angle = IC_AngleAVX2(image, keypoint->pt, umax);
+    }
+    return;
+  }
+#endif
+
   for (vector<KeyPoint>::iterator keypoint = keypoints.begin(),
                                   keypointEnd = keypoints.end();
        keypoint != keypointEnd; ++keypoint) {
@@ -464,264 +594,6 @@ static void computeOrientation(const Mat &image, vector<KeyPoint> &keypoints,
   }
 }
 
-void ExtractorNode::DivideNode(ExtractorNode &n1, ExtractorNode &n2,
-                               ExtractorNode &n3, ExtractorNode &n4) {
-  const int halfX = ceil(static_cast<float>(UR.x - UL.x) / 2);
-  const int halfY = ceil(static_cast<float>(BR.y - UL.y) / 2);
-
-  // Define boundaries of childs
-  n1.UL = UL;
-  n1.UR = cv::Point2i(UL.x + halfX, UL.y);
-  n1.BL = cv::Point2i(UL.x, UL.y + halfY);
-  n1.BR = cv::Point2i(UL.x + halfX, UL.y + halfY);
-  n1.vKeys.reserve(vKeys.size());
-
-  n2.UL = n1.UR;
-  n2.UR = UR;
-  n2.BL = n1.BR;
-  n2.BR = cv::Point2i(UR.x, UL.y + halfY);
-  n2.vKeys.reserve(vKeys.size());
-
-  n3.UL = n1.BL;
-  n3.UR = n1.BR;
-  n3.BL = BL;
-  n3.BR = cv::Point2i(n1.BR.x, BL.y);
-  n3.vKeys.reserve(vKeys.size());
-
-  n4.UL = n3.UR;
-  n4.UR = n2.BR;
-  n4.BL = n3.BR;
-  n4.BR = BR;
-  n4.vKeys.reserve(vKeys.size());
-
-  // Associate points to childs
-  for (size_t i = 0; i < vKeys.size(); i++) {
-    const cv::KeyPoint &kp = vKeys[i];
-    if (kp.pt.x < n1.UR.x) {
-      if (kp.pt.y < n1.BR.y)
-        n1.vKeys.push_back(kp);
-      else
-        n3.vKeys.push_back(kp);
-    } else if (kp.pt.y < n1.BR.y)
-      n2.vKeys.push_back(kp);
-    else
-      n4.vKeys.push_back(kp);
-  }
-
-  if (n1.vKeys.size() == 1)
-    n1.bNoMore = true;
-  if (n2.vKeys.size() == 1)
-    n2.bNoMore = true;
-  if (n3.vKeys.size() == 1)
-    n3.bNoMore = true;
-  if (n4.vKeys.size() == 1)
-    n4.bNoMore = true;
-}
-
-vector<cv::KeyPoint>
-ORBextractor::DistributeOctTree(const vector<cv::KeyPoint> &vToDistributeKeys,
-                                const int &minX, const int &maxX,
-                                const int &minY, const int &maxY, const int &N,
-                                const int &level) {
-  // Compute how many initial nodes
-  const int nIni = round(static_cast<float>(maxX - minX) / (maxY - minY));
-
-  const float hX = static_cast<float>(maxX - minX) / nIni;
-
-  list<ExtractorNode> lNodes;
-
-  vector<ExtractorNode *> vpIniNodes;
-  vpIniNodes.resize(nIni);
-
-  for (int i = 0; i < nIni; i++) {
-    ExtractorNode ni;
-    ni.UL = cv::Point2i(hX * static_cast<float>(i), 0);
-    ni.UR = cv::Point2i(hX * static_cast<float>(i + 1), 0);
-    ni.BL = cv::Point2i(ni.UL.x, maxY - minY);
-    ni.BR = cv::Point2i(ni.UR.x, maxY - minY);
-    ni.vKeys.reserve(vToDistributeKeys.size());
-
-    lNodes.push_back(ni);
-    vpIniNodes[i] = &lNodes.back();
-  }
-
-  // Associate points to childs
-  for (size_t i = 0; i < vToDistributeKeys.size(); i++) {
-    const cv::KeyPoint &kp = vToDistributeKeys[i];
-    vpIniNodes[kp.pt.x / hX]->vKeys.push_back(kp);
-  }
-
-  list<ExtractorNode>::iterator lit = lNodes.begin();
-
-  while (lit != lNodes.end()) {
-    if (lit->vKeys.size() == 1) {
-      lit->bNoMore = true;
-      lit++;
-    } else if (lit->vKeys.empty())
-      lit = lNodes.erase(lit);
-    else
-      lit++;
-  }
-
-  bool bFinish = false;
-
-  int iteration = 0;
-
-  vector<pair<int, ExtractorNode *>> vSizeAndPointerToNode;
-  vSizeAndPointerToNode.reserve(lNodes.size() * 4);
-
-  while (!bFinish) {
-    iteration++;
-
-    int prevSize = lNodes.size();
-
-    lit = lNodes.begin();
-
-    int nToExpand = 0;
-
-    vSizeAndPointerToNode.clear();
-
-    while (lit != lNodes.end()) {
-      if (lit->bNoMore) {
-        // If node only contains one point do not subdivide and continue
-        lit++;
-        continue;
-      } else {
-        // If more than one point, subdivide
-        ExtractorNode n1, n2, n3, n4;
-        lit->DivideNode(n1, n2, n3, n4);
-
-        // Add childs if they contain points
-        if (n1.vKeys.size() > 0) {
-          lNodes.push_front(n1);
-          if (n1.vKeys.size() > 1) {
-            nToExpand++;
-            vSizeAndPointerToNode.push_back(
-                make_pair(n1.vKeys.size(), &lNodes.front()));
-            lNodes.front().lit = lNodes.begin();
-          }
-        }
-        if (n2.vKeys.size() > 0) {
-          lNodes.push_front(n2);
-          if (n2.vKeys.size() > 1) {
-            nToExpand++;
-            vSizeAndPointerToNode.push_back(
-                make_pair(n2.vKeys.size(), &lNodes.front()));
-            lNodes.front().lit = lNodes.begin();
-          }
-        }
-        if (n3.vKeys.size() > 0) {
-          lNodes.push_front(n3);
-          if (n3.vKeys.size() > 1) {
-            nToExpand++;
-            vSizeAndPointerToNode.push_back(
-                make_pair(n3.vKeys.size(), &lNodes.front()));
-            lNodes.front().lit = lNodes.begin();
-          }
-        }
-        if (n4.vKeys.size() > 0) {
-          lNodes.push_front(n4);
-          if (n4.vKeys.size() > 1) {
-            nToExpand++;
-            vSizeAndPointerToNode.push_back(
-                make_pair(n4.vKeys.size(), &lNodes.front()));
-            lNodes.front().lit = lNodes.begin();
-          }
-        }
-
-        lit = lNodes.erase(lit);
-        continue;
-      }
-    }
-
-    // Finish if there are more nodes than required features
-    // or all nodes contain just one point
-    if ((int)lNodes.size() >= N || (int)lNodes.size() == prevSize) {
-      bFinish = true;
-    } else if (((int)lNodes.size() + nToExpand * 3) > N) {
-
-      while (!bFinish) {
-
-        prevSize = lNodes.size();
-
-        vector<pair<int, ExtractorNode *>> vPrevSizeAndPointerToNode =
-            vSizeAndPointerToNode;
-        vSizeAndPointerToNode.clear();
-
-        sort(vPrevSizeAndPointerToNode.begin(),
-             vPrevSizeAndPointerToNode.end());
-        for (int j = vPrevSizeAndPointerToNode.size() - 1; j >= 0; j--) {
-          ExtractorNode n1, n2, n3, n4;
-          vPrevSizeAndPointerToNode[j].second->DivideNode(n1, n2, n3, n4);
-
-          // Add childs if they contain points
-          if (n1.vKeys.size() > 0) {
-            lNodes.push_front(n1);
-            if (n1.vKeys.size() > 1) {
-              vSizeAndPointerToNode.push_back(
-                  make_pair(n1.vKeys.size(), &lNodes.front()));
-              lNodes.front().lit = lNodes.begin();
-            }
-          }
-          if (n2.vKeys.size() > 0) {
-            lNodes.push_front(n2);
-            if (n2.vKeys.size() > 1) {
-              vSizeAndPointerToNode.push_back(
-                  make_pair(n2.vKeys.size(), &lNodes.front()));
-              lNodes.front().lit = lNodes.begin();
-            }
-          }
-          if (n3.vKeys.size() > 0) {
-            lNodes.push_front(n3);
-            if (n3.vKeys.size() > 1) {
-              vSizeAndPointerToNode.push_back(
-                  make_pair(n3.vKeys.size(), &lNodes.front()));
-              lNodes.front().lit = lNodes.begin();
-            }
-          }
-          if (n4.vKeys.size() > 0) {
-            lNodes.push_front(n4);
-            if (n4.vKeys.size() > 1) {
-              vSizeAndPointerToNode.push_back(
-                  make_pair(n4.vKeys.size(), &lNodes.front()));
-              lNodes.front().lit = lNodes.begin();
-            }
-          }
-
-          lNodes.erase(vPrevSizeAndPointerToNode[j].second->lit);
-
-          if ((int)lNodes.size() >= N)
-            break;
-        }
-
-        if ((int)lNodes.size() >= N || (int)lNodes.size() == prevSize)
-          bFinish = true;
-      }
-    }
-  }
-
-  // Retain the best point in each node
-  vector<cv::KeyPoint> vResultKeys;
-  vResultKeys.reserve(nfeatures);
-  for (list<ExtractorNode>::iterator lit = lNodes.begin(); lit != lNodes.end();
-       lit++) {
-    vector<cv::KeyPoint> &vNodeKeys = lit->vKeys;
-    cv::KeyPoint *pKP = &vNodeKeys[0];
-    float maxResponse = pKP->response;
-
-    for (size_t k = 1; k < vNodeKeys.size(); k++) {
-      if (vNodeKeys[k].response > maxResponse) {
-        pKP = &vNodeKeys[k];
-        maxResponse = vNodeKeys[k].response;
-      }
-    }
-
-    vResultKeys.push_back(*pKP);
-  }
-
-  return vResultKeys;
-}
-
 void ORBextractor::ComputeKeyPointsOctTree(
     vector<vector<KeyPoint>> &allKeypoints) {
   allKeypoints.resize(nlevels);
@@ -783,11 +655,8 @@ void ORBextractor::ComputeKeyPointsOctTree(
     }
 
     vector<KeyPoint> &keypoints = allKeypoints[level];
-    keypoints.reserve(nfeatures);
-
-    keypoints =
-        DistributeOctTree(vToDistributeKeys, minBorderX, maxBorderX, minBorderY,
-                          maxBorderY, mnFeaturesPerLevel[level], level);
+    mQuadtree.Distribute(vToDistributeKeys, minBorderX, maxBorderX, minBorderY,
+                         maxBorderY, mnFeaturesPerLevel[level], keypoints);
 
     const int scaledPatchSize = PATCH_SIZE * mvScaleFactor[level];
 
@@ -963,11 +832,37 @@ static void computeDescriptors(const Mat &image, vector<KeyPoint> &keypoints,
                                Mat &descriptors, const vector<Point> &pattern) {
   descriptors = Mat::zeros((int)keypoints.size(), 32, CV_8UC1);
 
+#ifdef ORB_AVX2_DISPATCH
+  if (UseAVX2()) {
+    // Split the pattern pairs into first / second point coordinates
+    float px[512], py[512];
+    for (int i = 0; i < 256; i++) {
+      px[i] = (float)pattern[2 * i].x;
+      py[i] = (float)pattern[2 * i].y;
+      px[256 + i] = (float)pattern[2 * i + 1].x;
+      py[256 + i] = (float)pattern[2 * i + 1].y;
+    }
+
+    for (size_t i = 0; i < keypoints.size(); i++)
+      computeOrbDescriptorAVX2(keypoints[i], image, px, py,
+                               descriptors.ptr((int)i));
+    return;
+  }
+#endif
+
   for (size_t i = 0; i < keypoints.size(); i++)
     computeOrbDescriptor(keypoints[i], image, &pattern[0],
                          descriptors.ptr((int)i));
 }
 
+void ORBextractor::ComputeOrientation(const Mat &image, vector<KeyPoint> &keypoints) const {
+  computeOrientation(image, keypoints, umax);
+}
+
+void ORBextractor::ComputeDescriptors(const Mat &image, vector<KeyPoint> &keypoints, Mat &descriptors) const {
+  computeDescriptors(image, keypoints, descriptors, pattern);
+}
+
 void ORBextractor::operator()(InputArray _image, InputArray _mask,
                               vector<KeyPoint> &_keypoints,
                               OutputArray _descriptors) {
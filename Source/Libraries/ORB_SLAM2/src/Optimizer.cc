@@ -574,14 +574,14 @@ int Optimizer::PoseOptimizationMultiChannels(Frame *pFrame) {
             pFrame->Channels[Ftype].mvbOutlier[i] = false;
 
             Eigen::Matrix<double, 2, 1> obs;
-            const cv::KeyPoint &kpUn = pFrame->Channels[Ftype].mvKeysUn[i];
-            obs << kpUn.pt.x, kpUn.pt.y;
+            const KeyPointArray &keysUn = pFrame->Channels[Ftype].mKeysUnSoA;
+            obs << keysUn.x[i], keysUn.y[i];
 
             g2o::EdgeSE3ProjectXYZOnlyPose *e = new g2o::EdgeSE3ProjectXYZOnlyPose();
 
             e->setVertex(0, dynamic_cast<g2o::OptimizableGraph::Vertex *>(optimizer.vertex(0)));
             e->setMeasurement(obs);
-            const float invSigma2 = pFrame->mvInvLevelSigma2[kpUn.octave];
+            const float invSigma2 = pFrame->mvInvLevelSigma2[keysUn.octave[i]];
             e->setInformation(Eigen::Matrix2d::Identity() * invSigma2);
 
             g2o::RobustKernelHuber *rk = new g2o::RobustKernelHuber;
@@ -608,15 +608,15 @@ int Optimizer::PoseOptimizationMultiChannels(Frame *pFrame) {
 
             // SET EDGE
             Eigen::Matrix<double, 3, 1> obs;
-            const cv::KeyPoint &kpUn = pFrame->Channels[Ftype].mvKeysUn[i];
+            const KeyPointArray &keysUn = pFrame->Channels[Ftype].mKeysUnSoA;
             const float &kp_ur = pFrame->Channels[Ftype].mvuRight[i];
-            obs << kpUn.pt.x, kpUn.pt.y, kp_ur;
+            obs << keysUn.x[i], keysUn.y[i], kp_ur;
 
             g2o::EdgeStereoSE3ProjectXYZOnlyPose *e = new g2o::EdgeStereoSE3ProjectXYZOnlyPose();
 
             e->setVertex(0, dynamic_cast<g2o::OptimizableGraph::Vertex *>(optimizer.vertex(0)));
             e->setMeasurement(obs);
-            const float invSigma2 = pFrame->mvInvLevelSigma2[kpUn.octave];
+            const float invSigma2 = pFrame->mvInvLevelSigma2[keysUn.octave[i]];
             Eigen::Matrix3d Info = Eigen::Matrix3d::Identity() * invSigma2;
             e->setInformation(Info);
 
@@ -82,6 +82,15 @@ void SIFTextractor::operator()(cv::InputArray image, cv::InputArray mask,
     }
 }
 
+void SIFTextractor::SetNumFeatures(int n)
+{
+    FeatureExtractor::SetNumFeatures(n);
+    mpSIFT = cv::SIFT::create(nfeatures, nOctaves,
+                              contrastThreshold,
+                              edgeThreshold,
+                              sigma);
+}
+
 void SIFTextractor::ForceLinking(){}
 
 } // namespace ORB_SLAM2
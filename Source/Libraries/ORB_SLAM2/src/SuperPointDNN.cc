@@ -0,0 +1,224 @@
+/**
+ * >>> OpenCV DNN port of SuperSLAM::SPDetector <<<
+ *  By Howard Cui <haoyangcui at outlook dot com>
+ *
+ * This file is part of SuperSLAM.
+ *
+ * Copyright (C) Aditya Wagh <adityamwagh at outlook dot com>
+ * For more information see <https://github.com/adityamwagh/SuperSLAM>
+ *
+ * SuperSLAM is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SuperSLAM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SuperSLAM. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "SuperPointDNN.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace SuperSLAM {
+
+SPDetectorDNN::SPDetectorDNN(const std::string& onnxPath, bool cuda) {
+  try {
+    mNet = cv::dnn::readNetFromONNX(onnxPath);
+  } catch (const cv::Exception& e) {
+    throw std::runtime_error(
+        std::string("[SuperPoint] load ONNX model failed: ") + e.what());
+  }
+  if (mNet.empty())
+    throw std::runtime_error("[SuperPoint] load ONNX model failed: " +
+                             onnxPath);
+
+#if CV_VERSION_MAJOR > 4 || (CV_VERSION_MAJOR == 4 && CV_VERSION_MINOR >= 2)
+  if (cuda) {
+    mNet.setPreferableBackend(cv::dnn::DNN_BACKEND_CUDA);
+    mNet.setPreferableTarget(cv::dnn::DNN_TARGET_CUDA);
+  } else
+#endif
+  {
+    mNet.setPreferableBackend(cv::dnn::DNN_BACKEND_OPENCV);
+    mNet.setPreferableTarget(cv::dnn::DNN_TARGET_CPU);
+  }
+
+  mvOutNames = mNet.getUnconnectedOutLayersNames();
+}
+
+void SPDetectorDNN::detect(cv::Mat& img) {
+  forward(img);
+  mProb = mProbAll;
+  mDesc = mDescAll;
+}
+
+void SPDetectorDNN::forward(const cv::Mat& img) {
+  cv::dnn::blobFromImage(img, mBlob, 1.0 / 255.0, cv::Size(), cv::Scalar(),
+                         false, false, CV_32F);
+  mNet.setInput(mBlob);
+  mNet.forward(mvOuts, mvOutNames);
+
+  // Outputs are told apart by their channel count, not by name
+  const cv::Mat* semi = nullptr;
+  const cv::Mat* desc = nullptr;
+  for (const cv::Mat& out : mvOuts) {
+    if (out.dims != 4) continue;
+    if (out.size[1] == 65) semi = &out;
+    if (out.size[1] == 256) desc = &out;
+  }
+  if (!semi || !desc)
+    throw std::runtime_error(
+        "[SuperPoint] ONNX model must output semi [1, 65, H/8, W/8] and "
+        "desc [1, 256, H/8, W/8]");
+
+  const int Hc = semi->size[2];
+  const int Wc = semi->size[3];
+  const size_t plane = (size_t)Hc * Wc;
+
+  // Softmax over the 65 bins of each cell, drop the dustbin and scatter the
+  // 64 remaining bins to the 8x8 pixels of the cell
+  mProbAll.create(Hc * 8, Wc * 8, CV_32F);
+  const float* pSemi = semi->ptr<float>();
+  float bins[65];
+  for (int cy = 0; cy < Hc; cy++) {
+    for (int cx = 0; cx < Wc; cx++) {
+      const float* s = pSemi + cy * Wc + cx;
+      float maxv = s[0];
+      for (int k = 1; k < 65; k++) maxv = std::max(maxv, s[k * plane]);
+      float sum = 0.f;
+      for (int k = 0; k < 65; k++) {
+        bins[k] = std::exp(s[k * plane] - maxv);
+        sum += bins[k];
+      }
+      const float inv = 1.f / sum;
+      for (int r = 0; r < 8; r++) {
+        float* row = mProbAll.ptr<float>(cy * 8 + r) + cx * 8;
+        for (int c = 0; c < 8; c++) row[c] = bins[r * 8 + c] * inv;
+      }
+    }
+  }
+
+  // L2-normalize the descriptor of each cell
+  const int sizes[4] = {1, 256, Hc, Wc};
+  mDescAll.create(4, sizes, CV_32F);
+  const float* pDesc = desc->ptr<float>();
+  float* pOut = mDescAll.ptr<float>();
+  for (size_t i = 0; i < plane; i++) {
+    float sq = 0.f;
+    for (int k = 0; k < 256; k++) sq += pDesc[k * plane + i] * pDesc[k * plane + i];
+    const float inv = sq > 0.f ? 1.f / std::sqrt(sq) : 0.f;
+    for (int k = 0; k < 256; k++) pOut[k * plane + i] = pDesc[k * plane + i] * inv;
+  }
+}
+
+void SPDetectorDNN::detectMosaic(const std::vector<cv::Mat>& images) {
+  const int nImages = images.size();
+  mvProb.resize(nImages);
+  mvDesc.resize(nImages);
+  if (nImages == 0) return;
+
+  cv::Mat mosaic;
+  std::vector<cv::Rect> vTiles;
+  packMosaic(images, mosaic, vTiles);
+
+  forward(mosaic);
+
+  // Same extent as a single-image forward pass: floor(H/8) x floor(W/8) cells
+  for (int i = 0; i < nImages; i++) {
+    const cv::Rect& r = vTiles[i];
+    const int Hc = r.height / 8;
+    const int Wc = r.width / 8;
+    mvProb[i] = mProbAll(cv::Rect(r.x, r.y, Wc * 8, Hc * 8));
+    const cv::Range ranges[4] = {cv::Range::all(), cv::Range::all(),
+                                 cv::Range(r.y / 8, r.y / 8 + Hc),
+                                 cv::Range(r.x / 8, r.x / 8 + Wc)};
+    mvDesc[i] = mDescAll(ranges);
+  }
+}
+
+void SPDetectorDNN::selectLevel(int level) {
+  mProb = mvProb[level];
+  mDesc = mvDesc[level];
+}
+
+void SPDetectorDNN::getKeyPoints(float iniThreshold, float minThreshold,
+                                 int iniX, int maxX, int iniY, int maxY,
+                                 int wCell, int hCell,
+                                 std::vector<cv::KeyPoint>& keypoints,
+                                 bool nms) {
+  keypoints.clear();
+
+  maxX = std::min(maxX, mProb.cols);
+  maxY = std::min(maxY, mProb.rows);
+  const int width = maxX - iniX;
+  const int height = maxY - iniY;
+  if (width <= 0 || height <= 0) return;
+
+  selectKeyPoints(mProb(cv::Rect(iniX, iniY, width, height)), iniThreshold,
+                  minThreshold, wCell, hCell, keypoints, nms);
+}
+
+void SPDetectorDNN::computeDescriptors(
+    const std::vector<cv::KeyPoint>& keypoints, cv::Mat& descriptors) {
+  const int n = keypoints.size();
+  descriptors.create(n, 256, CV_32F);
+  descriptors.setTo(0.f);
+  if (n == 0) return;
+
+  const int Hc = mDesc.size[2];
+  const int Wc = mDesc.size[3];
+  const size_t sC = mDesc.step[1] / sizeof(float);
+  const size_t sY = mDesc.step[2] / sizeof(float);
+  const float* base = mDesc.ptr<float>();
+
+  // Bilinear sampling with zero padding and align_corners, as
+  // torch::grid_sampler(mDesc, grid, 0, 0, true) in SPDetector
+  for (int i = 0; i < n; i++) {
+    const float gx = 2.f * keypoints[i].pt.x / mProb.cols - 1.f;
+    const float gy = 2.f * keypoints[i].pt.y / mProb.rows - 1.f;
+    const float ix = (gx + 1.f) / 2.f * (Wc - 1);
+    const float iy = (gy + 1.f) / 2.f * (Hc - 1);
+
+    const int x0 = (int)std::floor(ix);
+    const int y0 = (int)std::floor(iy);
+    const float ax = ix - x0;
+    const float ay = iy - y0;
+
+    const int xs[4] = {x0, x0 + 1, x0, x0 + 1};
+    const int ys[4] = {y0, y0, y0 + 1, y0 + 1};
+    const float ws[4] = {(1.f - ax) * (1.f - ay), ax * (1.f - ay),
+                         (1.f - ax) * ay, ax * ay};
+
+    float* out = descriptors.ptr<float>(i);
+    for (int k = 0; k < 4; k++) {
+      if (xs[k] < 0 || xs[k] >= Wc || ys[k] < 0 || ys[k] >= Hc) continue;
+      const float* d = base + ys[k] * sY + xs[k];
+      const float w = ws[k];
+      for (int c = 0; c < 256; c++) out[c] += w * d[c * sC];
+    }
+  }
+
+  // Same normalization as SPDetector::computeDescriptors: the sampled
+  // [256, n] tensor is normalized along the keypoint dimension
+  std::vector<float> vNorm(256, 0.f);
+  for (int i = 0; i < n; i++) {
+    const float* row = descriptors.ptr<float>(i);
+    for (int c = 0; c < 256; c++) vNorm[c] += row[c] * row[c];
+  }
+  for (int c = 0; c < 256; c++)
+    vNorm[c] = vNorm[c] > 0.f ? 1.f / std::sqrt(vNorm[c]) : 0.f;
+  for (int i = 0; i < n; i++) {
+    float* row = descriptors.ptr<float>(i);
+    for (int c = 0; c < 256; c++) row[c] *= vNorm[c];
+  }
+}
+
+}  // namespace SuperSLAM
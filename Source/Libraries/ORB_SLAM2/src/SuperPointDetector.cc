@@ -0,0 +1,110 @@
+/**
+ * >>> Part of the modified SuperSLAM SuperPoint detector <<<
+ *  By Howard Cui <haoyangcui at outlook dot com>
+ *
+ * This file is part of SuperSLAM.
+ *
+ * Copyright (C) Aditya Wagh <adityamwagh at outlook dot com>
+ * For more information see <https://github.com/adityamwagh/SuperSLAM>
+ *
+ * SuperSLAM is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SuperSLAM is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with SuperSLAM. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "SuperPointDetector.h"
+
+#include <algorithm>
+#include <opencv2/imgproc/imgproc.hpp>
+
+namespace SuperSLAM {
+
+static inline int roundUp8(int v) { return (v + 7) / 8 * 8; }
+
+void SPDetectorBase::packMosaic(const std::vector<cv::Mat>& images,
+                                cv::Mat& mosaic,
+                                std::vector<cv::Rect>& vTiles) {
+  const int nImages = images.size();
+  vTiles.resize(nImages);
+
+  // Tiles start on the 8x8 cell grid and are separated by one empty cell so
+  // that the semi/desc cells of each tile map back to its own image.
+  const int gap = 8;
+
+  // Shelf packing, the mosaic is as wide as the two largest images side by side
+  int mosaicW = roundUp8(images[0].cols);
+  if (nImages > 1) mosaicW += gap + roundUp8(images[1].cols);
+
+  int x = 0, y = 0, shelfH = 0;
+  for (int i = 0; i < nImages; i++) {
+    const int w = images[i].cols;
+    const int h = images[i].rows;
+    if (x > 0 && x + w > mosaicW) {
+      x = 0;
+      y += shelfH + gap;
+      shelfH = 0;
+    }
+    vTiles[i] = cv::Rect(x, y, w, h);
+    x += roundUp8(w) + gap;
+    shelfH = std::max(shelfH, roundUp8(h));
+  }
+
+  mosaic.create(y + shelfH, mosaicW, CV_8UC1);
+  mosaic.setTo(cv::Scalar(0));
+  for (int i = 0; i < nImages; i++)
+    images[i].copyTo(mosaic(vTiles[i]));
+}
+
+void SPDetectorBase::selectKeyPoints(const cv::Mat& prob, float iniThreshold,
+                                     float minThreshold, int wCell, int hCell,
+                                     std::vector<cv::KeyPoint>& keypoints,
+                                     bool nms) {
+  const int width = prob.cols;
+  const int height = prob.rows;
+
+  // NMS: a point survives if it is the maximum of its (2r+1)^2 neighbourhood
+  const int dist_thresh = 4;
+  if (nms)
+    cv::dilate(prob, mProbMax,
+               cv::Mat::ones(2 * dist_thresh + 1, 2 * dist_thresh + 1, CV_8U));
+
+  const int nCols = (width + wCell - 1) / wCell;
+  const int nRows = (height + hCell - 1) / hCell;
+  mvCellKeys.resize(nCols * nRows);
+  for (auto& vCell : mvCellKeys) vCell.clear();
+  mvCellStrong.assign(nCols * nRows, 0);
+
+  for (int y = 0; y < height; y++) {
+    const float* row = prob.ptr<float>(y);
+    const float* rowMax = nms ? mProbMax.ptr<float>(y) : row;
+    const int cellRow = (y / hCell) * nCols;
+
+    for (int x = 0; x < width; x++) {
+      const float response = row[x];
+      if (response <= minThreshold || response < rowMax[x]) continue;
+
+      const int cell = cellRow + x / wCell;
+      mvCellKeys[cell].emplace_back((float)x, (float)y, 8, -1, response);
+      if (response > iniThreshold) mvCellStrong[cell] = 1;
+    }
+  }
+
+  // Cells with a point above iniThreshold only keep those
+  for (size_t c = 0; c < mvCellKeys.size(); c++) {
+    for (const auto& kp : mvCellKeys[c]) {
+      if (mvCellStrong[c] && kp.response <= iniThreshold) continue;
+      keypoints.push_back(kp);
+    }
+  }
+}
+
+}  // namespace SuperSLAM
@@ -70,9 +70,10 @@
 namespace ORB_SLAM2 {
 
 using SuperSLAM::SPDetector;
+using SuperSLAM::SPDetectorDNN;
 
 SuperPointExtractor::SuperPointExtractor(
-    const cv::FileNode& cfg, bool init)
+    const cv::FileNode& cfg, bool init, const std::string& backend)
   : FeatureExtractor(cfg, init)
 {
   iniTh        = cfg["iniTh"].empty()     ? 0.08f   : (float)cfg["iniTh"];
@@ -80,6 +81,47 @@ SuperPointExtractor::SuperPointExtractor(
   mUseCUDA     = cfg["use_cuda"].empty()  ? false  : ((int)cfg["use_cuda"] != 0);
   mUseNMS      = cfg["nms"].empty()       ? true   : ((int)cfg["nms"] != 0);
   mWeightsPath = cfg["weights"].empty()   ? std::string() : (std::string)cfg["weights"];
+  mBatchLevels = cfg["batch_levels"].empty() ? false : ((int)cfg["batch_levels"] != 0);
+  mBackend     = cfg["backend"].empty()   ? std::string("eager") : (std::string)cfg["backend"];
+  if (!backend.empty()) mBackend = backend;
+  mChannelsLast = cfg["channels_last"].empty() ? false : ((int)cfg["channels_last"] != 0);
+
+  // TorchScript backends: frozen fp32 graph, or a statically quantized int8 graph
+  if (mBackend == "jit" || mBackend == "jit_int8") {
+    const bool bInt8 = (mBackend == "jit_int8");
+    const char* key = bInt8 ? "jit_int8_model" : "jit_model";
+    mModelPath = cfg[key].empty() ? std::string() : (std::string)cfg[key];
+    if (mModelPath.empty())
+      throw std::runtime_error(std::string("[SuperPoint] backend '") + mBackend + "' requires '" + key + "'");
+
+    if (bInt8) {
+      const auto& engines = at::globalContext().supportedQEngines();
+      if (std::find(engines.begin(), engines.end(), at::QEngine::FBGEMM) != engines.end())
+        at::globalContext().setQEngine(at::QEngine::FBGEMM);
+    }
+
+    torch::jit::script::Module module;
+    try {
+      module = torch::jit::load(mModelPath);
+    } catch (const std::exception& e) {
+      throw std::runtime_error(std::string("[SuperPoint] load TorchScript model failed: ") + e.what());
+    }
+
+    mDetector = std::make_unique<SPDetector>(module, mUseCUDA, mChannelsLast);
+    return;
+  }
+
+  // OpenCV DNN backend: same network from an ONNX export, LibTorch is not used
+  if (mBackend == "onnx") {
+    mModelPath = cfg["onnx_model"].empty() ? std::string() : (std::string)cfg["onnx_model"];
+    if (mModelPath.empty())
+      throw std::runtime_error("[SuperPoint] backend 'onnx' requires 'onnx_model'");
+
+    mDetector = std::make_unique<SPDetectorDNN>(mModelPath, mUseCUDA);
+    return;
+  }
+  if (mBackend != "eager")
+    throw std::runtime_error("[SuperPoint] unknown backend '" + mBackend + "'");
 
   mModel = std::make_shared<SuperSLAM::SuperPoint>();
   if (!mWeightsPath.empty()) {
@@ -100,7 +142,7 @@ SuperPointExtractor::SuperPointExtractor(
   mModel->eval();
   if (mUseCUDA) mModel->to(torch::kCUDA);
 
-  mDetector = std::make_unique<SPDetector>(mModel, mUseCUDA);
+  mDetector = std::make_unique<SPDetector>(mModel, mUseCUDA, mChannelsLast);
 }
 
 void SuperPointExtractor::InfoConfigs() {
@@ -109,137 +151,13 @@ void SuperPointExtractor::InfoConfigs() {
   std::cout << "- Scale Factor: " << scaleFactor << std::endl;
   std::cout << "- Use CUDA: " << mUseCUDA << std::endl;
   std::cout << "- Use NMS: " << mUseNMS << std::endl;
+  std::cout << "- Batch Levels: " << mBatchLevels << std::endl;
+  std::cout << "- Backend: " << mBackend << std::endl;
+  std::cout << "- Channels Last: " << mChannelsLast << std::endl;
   std::cout << "- iniTh: " << iniTh << std::endl;
   std::cout << "- minTh: " << minTh << std::endl;
 }
 
-void SuperPointExtractor::ExtractorNode::DivideNode(
-    ExtractorNode& n1, ExtractorNode& n2, ExtractorNode& n3, ExtractorNode& n4)
-{
-  const int halfX = (UR.x - UL.x) / 2;
-  const int halfY = (BR.y - UL.y) / 2;
-
-  n1.UL = UL;
-  n1.UR = cv::Point2i(UL.x + halfX, UL.y);
-  n1.BL = cv::Point2i(UL.x, UL.y + halfY);
-  n1.BR = cv::Point2i(UL.x + halfX, UL.y + halfY);
-
-  n2.UL = n1.UR;
-  n2.UR = UR;
-  n2.BL = n1.BR;
-  n2.BR = cv::Point2i(UR.x, UL.y + halfY);
-
-  n3.UL = n1.BL;
-  n3.UR = n1.BR;
-  n3.BL = BL;
-  n3.BR = cv::Point2i(UL.x + halfX, BL.y);
-
-  n4.UL = n3.UR;
-  n4.UR = n2.BR;
-  n4.BL = n3.BR;
-  n4.BR = BR;
-
-  for (const auto& kp : vKeys) {
-    if (kp.pt.x < n1.UR.x) {
-      if (kp.pt.y < n1.BR.y) n1.vKeys.push_back(kp);
-      else n3.vKeys.push_back(kp);
-    } else {
-      if (kp.pt.y < n1.BR.y) n2.vKeys.push_back(kp);
-      else                    n4.vKeys.push_back(kp);
-    }
-  }
-  n1.bNoMore = (n1.vKeys.size() <= 1);
-  n2.bNoMore = (n2.vKeys.size() <= 1);
-  n3.bNoMore = (n3.vKeys.size() <= 1);
-  n4.bNoMore = (n4.vKeys.size() <= 1);
-}
-
-std::vector<cv::KeyPoint> SuperPointExtractor::DistributeOctTree(
-    const std::vector<cv::KeyPoint>& vToDistributeKeys, const int& minX,
-    const int& maxX, const int& minY, const int& maxY, const int& N,
-    const int& level)
-{
-  if ((int)vToDistributeKeys.size() <= N) return vToDistributeKeys;
-
-  int nIni = std::round(static_cast<float>(maxX - minX) / (maxY - minY));
-  if (nIni < 1) nIni = 1;
-  const float hX = static_cast<float>(maxX - minX) / nIni;
-
-  std::list<ExtractorNode> lNodes;
-  std::vector<ExtractorNode*> vpIniNodes; vpIniNodes.resize(nIni);
-
-  for (int i = 0; i < nIni; i++) {
-    ExtractorNode ni;
-    ni.UL = cv::Point2i(hX * static_cast<float>(i), 0);
-    ni.UR = cv::Point2i(hX * static_cast<float>(i + 1), 0);
-    ni.BL = cv::Point2i(ni.UL.x, maxY - minY);
-    ni.BR = cv::Point2i(ni.UR.x, maxY - minY);
-    ni.vKeys.reserve(vToDistributeKeys.size());
-    lNodes.push_back(ni);
-    vpIniNodes[i] = &lNodes.back();
-  }
-
-  for (const auto& kp : vToDistributeKeys) {
-    int idx = std::min((int)std::floor((kp.pt.x - minX) / hX), nIni - 1);
-    if (idx < 0) idx = 0;
-    if (idx >= nIni) idx = nIni - 1;
-    vpIniNodes[idx]->vKeys.push_back(kp);
-  }
-
-  auto it = lNodes.begin();
-  while (it != lNodes.end()) {
-    if (it->vKeys.size() == 1) { it->bNoMore = true; ++it; continue; }
-    if (it->vKeys.empty()) { it = lNodes.erase(it); continue; }
-    ++it;
-  }
-
-  bool bFinish = false;
-  int nNodes = (int)lNodes.size();
-  std::vector<std::pair<int, std::list<ExtractorNode>::iterator>> vSizeAndPointer;
-  vSizeAndPointer.reserve(lNodes.size() * 4);
-
-  while (!bFinish) {
-    int prevSize = (int)lNodes.size();
-    it = lNodes.begin();
-    vSizeAndPointer.clear();
-
-    while (it != lNodes.end()) {
-      if (it->bNoMore) { ++it; continue; }
-
-      ExtractorNode n1, n2, n3, n4;
-      it->DivideNode(n1, n2, n3, n4);
-
-      if (!n1.vKeys.empty()) { lNodes.push_front(n1); lNodes.begin()->lit = lNodes.begin(); }
-      if (!n2.vKeys.empty()) { lNodes.push_front(n2); lNodes.begin()->lit = lNodes.begin(); }
-      if (!n3.vKeys.empty()) { lNodes.push_front(n3); lNodes.begin()->lit = lNodes.begin(); }
-      if (!n4.vKeys.empty()) { lNodes.push_front(n4); lNodes.begin()->lit = lNodes.begin(); }
-
-      it = lNodes.erase(it);
-      if ((int)lNodes.size() >= N) break;
-    }
-
-    if ((int)lNodes.size() >= N || (int)lNodes.size() == prevSize) {
-      bFinish = true;
-    }
-  }
-
-  std::vector<cv::KeyPoint> vResultKeys; vResultKeys.reserve(N);
-  for (auto lit = lNodes.begin(); lit != lNodes.end(); ++lit) {
-    auto& vNodeKeys = lit->vKeys;
-    if (vNodeKeys.empty()) continue;
-    auto kp = *std::max_element(vNodeKeys.begin(), vNodeKeys.end(),
-                                [](const cv::KeyPoint& a, const cv::KeyPoint& b){
-                                  return a.response < b.response;
-                                });
-    vResultKeys.push_back(kp);
-  }
-
-  if ((int)vResultKeys.size() > N) {
-    cv::KeyPointsFilter::retainBest(vResultKeys, N);
-  }
-  return vResultKeys;
-}
-
 void SuperPointExtractor::operator()(cv::InputArray image,
                                              cv::InputArray mask,
                                              std::vector<cv::KeyPoint>& keypoints,
@@ -262,14 +180,21 @@ void SuperPointExtractor::operator()(cv::InputArray image,
   std::vector<cv::Mat> vDesc; vDesc.reserve(nlevels);
 
   const float W = 30.f;
-  torch::NoGradGuard _no_grad;
+
+  auto& detector = *mDetector;
+
+  // One forward pass for the whole pyramid
+  if (mBatchLevels)
+    detector.detectMosaic(mvImagePyramid);
 
   for (int level = 0; level < nlevels; ++level)
   {
     const cv::Mat& imL = mvImagePyramid[level];
 
-    auto& detector = *mDetector;
-    detector.detect(const_cast<cv::Mat&>(imL));
+    if (mBatchLevels)
+      detector.selectLevel(level);
+    else
+      detector.detect(const_cast<cv::Mat&>(imL));
 
     // Valid area (coordinate system without borders)
     const int minBorderX = EDGE_THRESHOLD - 3;
@@ -287,40 +212,23 @@ void SuperPointExtractor::operator()(cv::InputArray image,
 
     std::vector<cv::KeyPoint> vToDistributeKeys; vToDistributeKeys.reserve(nfeatures * 8);
 
-    // Take points by grid (first high threshold then low threshold)
-    for (int i = 0; i < nRows; ++i) {
-      const float iniY = minBorderY + i * hCell;
-      float maxY = iniY + hCell + 6;
-      if (iniY >= maxBorderY - 3) continue;
-      if (maxY > maxBorderY) maxY = maxBorderY;
-
-      for (int j = 0; j < nCols; ++j) {
-        const float iniX = minBorderX + j * wCell;
-        float maxX = iniX + wCell + 6;
-        if (iniX >= maxBorderX - 6) continue;
-        if (maxX > maxBorderX) maxX = maxBorderX;
-
-        std::vector<cv::KeyPoint> vCell;
-
-        detector.getKeyPoints(iniTh, iniX, maxX, iniY, maxY, vCell, mUseNMS);
-        if (vCell.empty())
-          detector.getKeyPoints(minTh, iniX, maxX, iniY, maxY, vCell, mUseNMS);
-
-        for (auto& kp : vCell) {
-          kp.pt.x += j * wCell;
-          kp.pt.y += i * hCell;
-          vToDistributeKeys.emplace_back(std::move(kp));
-        }
-      }
-    }
+    // Take points by grid (first high threshold then low threshold), one pass over the level
+    detector.getKeyPoints(iniTh, minTh, minBorderX, maxBorderX, minBorderY, maxBorderY,
+                          wCell, hCell, vToDistributeKeys, mUseNMS);
 
     // OctTree homogenization + limit number
     auto& keypointsL = allKeypoints[level];
-    const int roiW = maxBorderX - minBorderX;
-    const int roiH = maxBorderY - minBorderY;
-    keypointsL = DistributeOctTree(vToDistributeKeys,
-                  0, roiW, 0, roiH,
-                  mnFeaturesPerLevel[level], level);
+    const int nLevelFeatures = mnFeaturesPerLevel[level];
+    if ((int)vToDistributeKeys.size() <= nLevelFeatures) {
+      keypointsL.swap(vToDistributeKeys);
+    } else {
+      const int roiW = maxBorderX - minBorderX;
+      const int roiH = maxBorderY - minBorderY;
+      mQuadtree.Distribute(vToDistributeKeys, 0, roiW, 0, roiH,
+                           nLevelFeatures, keypointsL);
+      if ((int)keypointsL.size() > nLevelFeatures)
+        cv::KeyPointsFilter::retainBest(keypointsL, nLevelFeatures);
+    }
 
     // Add back border offset, set octave/size
     const int scaledPatch = PATCH_SIZE * mvScaleFactor[level];
@@ -375,6 +283,10 @@ struct SuperPointRegister {
       [](const cv::FileNode& cfg, const bool init){
         return new ORB_SLAM2::SuperPointExtractor(cfg, init);
       });
+    ORB_SLAM2::FeatureExtractorFactory::Instance().Register("SuperPointDNN",
+      [](const cv::FileNode& cfg, const bool init){
+        return new ORB_SLAM2::SuperPointExtractor(cfg, init, "onnx");
+      });
   }
 };
 SuperPointRegister SuperPointRegisterInstance;
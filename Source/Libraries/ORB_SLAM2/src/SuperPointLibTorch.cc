@@ -129,6 +129,10 @@ std::vector<torch::Tensor> SuperPoint::forward(torch::Tensor x) {
   auto cDa = torch::relu(convDa->forward(x));
   auto desc = convDb->forward(cDa);  // [B, d1, H/8, W/8]
 
+  return decodeHeads(semi, desc);
+}
+
+std::vector<torch::Tensor> decodeHeads(torch::Tensor semi, torch::Tensor desc) {
   auto dn = torch::norm(desc, 2, 1);
   desc = desc.div(torch::unsqueeze(dn, 1));
 
@@ -152,12 +156,10 @@ std::vector<torch::Tensor> SuperPoint::forward(torch::Tensor x) {
 void NMS(cv::Mat det, cv::Mat conf, cv::Mat desc,
          std::vector<cv::KeyPoint>& pts, cv::Mat& descriptors, int border,
          int dist_thresh, int img_width, int img_height);
-void NMS2(std::vector<cv::KeyPoint> det, cv::Mat conf,
-          std::vector<cv::KeyPoint>& pts, int border, int dist_thresh,
-          int img_width, int img_height);
 
-SPDetector::SPDetector(std::shared_ptr<SuperPoint> _model, bool cuda)
-    : model(_model) {
+SPDetector::SPDetector(std::shared_ptr<SuperPoint> _model, bool cuda,
+                       bool channelsLast)
+    : model(_model), mbScripted(false), mbChannelsLast(channelsLast) {
   bool use_cuda = cuda && torch::cuda::is_available();
   // std::cout << "[SuperPointLibTorch] Using CUDA?: " << use_cuda << std::endl;
   torch::DeviceType device_type;
@@ -167,6 +169,28 @@ SPDetector::SPDetector(std::shared_ptr<SuperPoint> _model, bool cuda)
     device_type = torch::kCPU;
   m_device = device_type;
   model->to(m_device);
+  model->eval();
+
+  if (mbChannelsLast) {
+    torch::NoGradGuard no_grad;
+    for (auto& p : model->parameters())
+      if (p.dim() == 4)
+        p.set_data(p.contiguous(torch::MemoryFormat::ChannelsLast));
+  }
+}
+
+SPDetector::SPDetector(torch::jit::script::Module _module, bool cuda,
+                       bool channelsLast)
+    : mbScripted(true), mbChannelsLast(channelsLast) {
+  bool use_cuda = cuda && torch::cuda::is_available();
+  m_device = use_cuda ? torch::kCUDA : torch::kCPU;
+
+  // Freezing inlines the weights as constants, which lets the inference
+  // passes fold batch norms and fuse conv + relu (oneDNN on CPU).
+  _module.to(m_device);
+  _module.eval();
+  mModule = torch::jit::freeze(_module);
+  mModule = torch::jit::optimize_for_inference(mModule);
 }
 
 /*
@@ -185,6 +209,10 @@ void SPDetector::detect(cv::Mat& img) {
 */
 
 void SPDetector::detect(cv::Mat& img) {
+  forward(img);
+}
+
+void SPDetector::forward(const cv::Mat& img) {
   cv::Mat img_cont = img;
   if (!img_cont.isContinuous())
     img_cont = img_cont.clone();
@@ -196,54 +224,82 @@ void SPDetector::detect(cv::Mat& img) {
            ).clone();
 
   torch::NoGradGuard no_grad;
-  model->eval();
 
   x = x.to(m_device, torch::kFloat).div_(255.0f);
-
-  auto out = model->forward(x);
+  if (mbChannelsLast)
+    x = x.contiguous(torch::MemoryFormat::ChannelsLast);
+
+  std::vector<torch::Tensor> out;
+  if (mbScripted) {
+    auto heads = mModule.forward({x}).toTuple();
+    out = decodeHeads(heads->elements()[0].toTensor(),
+                      heads->elements()[1].toTensor());
+  } else {
+    out = model->forward(x);
+  }
   mProb = out[0].squeeze(0).contiguous();          // [H, W] on device
   mDesc = out[1];                                  // [1, 256, H/8, W/8] on device
   mProbCPU = mProb.to(torch::kCPU).contiguous();   // cache CPU copy (one per level)
 }
 
+void SPDetector::detectMosaic(const std::vector<cv::Mat>& images) {
+  const int nImages = images.size();
+  mvProb.resize(nImages);
+  mvDesc.resize(nImages);
+  mvProbCPU.resize(nImages);
+  if (nImages == 0) return;
+
+  cv::Mat mosaic;
+  std::vector<cv::Rect> vTiles;
+  packMosaic(images, mosaic, vTiles);
+
+  forward(mosaic);
+
+  // Same extent as a single-image forward pass: floor(H/8) x floor(W/8) cells
+  for (int i = 0; i < nImages; i++) {
+    const cv::Rect& r = vTiles[i];
+    const int Hc = r.height / 8;
+    const int Wc = r.width / 8;
+    mvProb[i] = mProb.slice(0, r.y, r.y + Hc * 8).slice(1, r.x, r.x + Wc * 8);
+    mvProbCPU[i] = mProbCPU.slice(0, r.y, r.y + Hc * 8).slice(1, r.x, r.x + Wc * 8);
+    mvDesc[i] = mDesc.slice(2, r.y / 8, r.y / 8 + Hc).slice(3, r.x / 8, r.x / 8 + Wc);
+  }
+}
 
-void SPDetector::getKeyPoints(float threshold, int iniX, int maxX, int iniY,
-                              int maxY, std::vector<cv::KeyPoint>& keypoints,
-                              bool nms) {
-  auto prob = mProbCPU.slice(0, iniY, maxY).slice(1, iniX, maxX);
-  auto kpts = (prob > threshold);
-  kpts = torch::nonzero(kpts);  // [n_keypoints, 2]  (y, x)
+void SPDetector::selectLevel(int level) {
+  mProb = mvProb[level];
+  mDesc = mvDesc[level];
+  mProbCPU = mvProbCPU[level];
+}
 
-  std::vector<cv::KeyPoint> keypoints_no_nms;
-  for (int i = 0; i < kpts.size(0); i++) {
-    float response = prob[kpts[i][0]][kpts[i][1]].item<float>();
-    keypoints_no_nms.push_back(cv::KeyPoint(
-        kpts[i][1].item<float>(), kpts[i][0].item<float>(), 8, -1, response));
-  }
 
-  if (nms) {
-    cv::Mat conf(keypoints_no_nms.size(), 1, CV_32F);
-    for (size_t i = 0; i < keypoints_no_nms.size(); i++) {
-      int x = keypoints_no_nms[i].pt.x;
-      int y = keypoints_no_nms[i].pt.y;
-      conf.at<float>(i, 0) = prob[y][x].item<float>();
-    }
+void SPDetector::getKeyPoints(float iniThreshold, float minThreshold,
+                              int iniX, int maxX, int iniY, int maxY,
+                              int wCell, int hCell,
+                              std::vector<cv::KeyPoint>& keypoints, bool nms) {
+  keypoints.clear();
 
-    // cv::Mat descriptors;
+  maxX = std::min(maxX, (int)mProbCPU.size(1));
+  maxY = std::min(maxY, (int)mProbCPU.size(0));
+  const int width = maxX - iniX;
+  const int height = maxY - iniY;
+  if (width <= 0 || height <= 0) return;
 
-    int border = 0;
-    int dist_thresh = 4;
-    int height = maxY - iniY;
-    int width = maxX - iniX;
+  // Raw view of the probability map (rows may be strided inside a mosaic)
+  const float* data = mProbCPU.data_ptr<float>();
+  const size_t stride = mProbCPU.stride(0);
+  const cv::Mat prob(height, width, CV_32F,
+                     const_cast<float*>(data + iniY * stride + iniX),
+                     stride * sizeof(float));
 
-    NMS2(keypoints_no_nms, conf, keypoints, border, dist_thresh, width, height);
-  } else {
-    keypoints = keypoints_no_nms;
-  }
+  selectKeyPoints(prob, iniThreshold, minThreshold, wCell, hCell, keypoints,
+                  nms);
 }
 
 void SPDetector::computeDescriptors(const std::vector<cv::KeyPoint>& keypoints,
                                     cv::Mat& descriptors) {
+  torch::NoGradGuard no_grad;
+
   cv::Mat kpt_mat(keypoints.size(), 2, CV_32F);  // [n_keypoints, 2]  (y, x)
 
   for (size_t i = 0; i < keypoints.size(); i++) {
@@ -279,97 +335,6 @@ void SPDetector::computeDescriptors(const std::vector<cv::KeyPoint>& keypoints,
   descriptors = desc_mat.clone();
 }
 
-void NMS2(std::vector<cv::KeyPoint> det, cv::Mat conf,
-          std::vector<cv::KeyPoint>& pts, int border, int dist_thresh,
-          int img_width, int img_height) {
-  std::vector<cv::Point2f> pts_raw;
-
-  for (int i = 0; i < det.size(); i++) {
-    int u = (int)det[i].pt.x;
-    int v = (int)det[i].pt.y;
-
-    pts_raw.push_back(cv::Point2f(u, v));
-  }
-
-  cv::Mat grid = cv::Mat(cv::Size(img_width, img_height), CV_8UC1);
-  cv::Mat inds = cv::Mat(cv::Size(img_width, img_height), CV_16UC1);
-
-  cv::Mat confidence = cv::Mat(cv::Size(img_width, img_height), CV_32FC1);
-
-  cv::copyMakeBorder(confidence, confidence,
-                   dist_thresh, dist_thresh, dist_thresh, dist_thresh,
-                   cv::BORDER_CONSTANT, 0.0f);;
-
-  cv::copyMakeBorder(conf, conf,
-                   dist_thresh, dist_thresh, dist_thresh, dist_thresh,
-                   cv::BORDER_CONSTANT, 0.0f);
-
-  grid.setTo(0);
-  inds.setTo(0);
-  confidence.setTo(0);
-
-  for (int i = 0; i < pts_raw.size(); i++) {
-    int uu = (int)pts_raw[i].x;
-    int vv = (int)pts_raw[i].y;
-
-    grid.at<char>(vv, uu) = 1;
-    inds.at<unsigned short>(vv, uu) = i;
-
-    confidence.at<float>(vv, uu) = conf.at<float>(i, 0);
-  }
-
-  cv::copyMakeBorder(grid, grid, dist_thresh, dist_thresh, dist_thresh,
-                     dist_thresh, cv::BORDER_CONSTANT, 0);
-
-  for (int i = 0; i < pts_raw.size(); i++) {
-    int uu = (int)pts_raw[i].x + dist_thresh;
-    int vv = (int)pts_raw[i].y + dist_thresh;
-
-    if (grid.at<char>(vv, uu) != 1) continue;
-
-    for (int k = -dist_thresh; k < (dist_thresh + 1); k++)
-      for (int j = -dist_thresh; j < (dist_thresh + 1); j++) {
-        if (j == 0 && k == 0) continue;
-
-        if (confidence.at<float>(vv + k, uu + j) < confidence.at<float>(vv, uu))
-          grid.at<char>(vv + k, uu + j) = 0;
-      }
-    grid.at<char>(vv, uu) = 2;
-  }
-
-  size_t valid_cnt = 0;
-  std::vector<int> select_indice;
-
-  for (int v = 0; v < (img_height + dist_thresh); v++) {
-    for (int u = 0; u < (img_width + dist_thresh); u++) {
-      if (u - dist_thresh >= (img_width - border) || u - dist_thresh < border ||
-          v - dist_thresh >= (img_height - border) || v - dist_thresh < border)
-        continue;
-
-      if (grid.at<char>(v, u) == 2) {
-        int select_ind =
-            (int)inds.at<unsigned short>(v - dist_thresh, u - dist_thresh);
-        cv::Point2f p = pts_raw[select_ind];
-        float response = conf.at<float>(select_ind, 0);
-        pts.push_back(cv::KeyPoint(p, 8.0f, -1, response));
-
-        select_indice.push_back(select_ind);
-        valid_cnt++;
-      }
-    }
-  }
-
-  // descriptors.create(select_indice.size(), 256, CV_32F);
-
-  // for (int i=0; i<select_indice.size(); i++)
-  // {
-  //     for (int j=0; j < 256; j++)
-  //     {
-  //         descriptors.at<float>(i, j) = desc.at<float>(select_indice[i], j);
-  //     }
-  // }
-}
-
 void NMS(cv::Mat det, cv::Mat conf, cv::Mat desc,
          std::vector<cv::KeyPoint>& pts, cv::Mat& descriptors, int border,
          int dist_thresh, int img_width, int img_height) {
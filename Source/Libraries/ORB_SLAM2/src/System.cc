@@ -20,6 +20,7 @@
 
 #include "System.h"
 #include "Converter.h"
+#include "ThreadBudget.h"
 #include <chrono>
 #include <iomanip>
 #include <pangolin/pangolin.h>
@@ -68,6 +69,13 @@ System::System(const string &strSettingsFile, const eSensor sensor, const bool b
   // Read setting config from the .yaml file
   cv::FileStorage fSettings(strSettingsFile, cv::FileStorage::READ);
   cv::FileNode extractorList = fSettings["Extractors"];
+
+  // CPU budget of the LibTorch / OpenCV pools and the SLAM threads, before any extractor exists.
+  // The threads pin themselves: Local Mapping and Loop Closing when they start, Tracking on its
+  // first frame (PinTrackingThread). The constructing thread is left alone, it usually goes on
+  // to run the Viewer.
+  ThreadBudget::init(fSettings["ThreadBudget"]);
+
   Ntype = extractorList.size();
   ExtractorNames.resize(Ntype);
 
@@ -170,6 +178,7 @@ cv::Mat System::TrackStereo(const cv::Mat &imLeft, const cv::Mat &imRight, const
          << endl;
     exit(-1);
   }
+  PinTrackingThread();
 
   // Check mode change
   {
@@ -216,6 +225,7 @@ cv::Mat System::TrackRGBD(const cv::Mat &im, const cv::Mat &depthmap, const doub
          << endl;
     exit(-1);
   }
+  PinTrackingThread();
 
   // Check mode change
   {
@@ -264,6 +274,7 @@ cv::Mat System::TrackMonocular(const cv::Mat &im, const double &timestamp) {
          << endl;
     exit(-1);
   }
+  PinTrackingThread();
 
   // Check mode change
   {
@@ -522,6 +533,15 @@ vector<cv::KeyPoint> System::GetTrackedKeyPointsUn() {
   return mTrackedKeyPointsUn;
 }
 
+void System::PinTrackingThread() {
+  // Tracking runs in the thread feeding the frames, which need not be the one that built the System
+  const std::thread::id id = std::this_thread::get_id();
+  if (id == mTrackingThreadId)
+    return;
+  mTrackingThreadId = id;
+  ThreadBudget::pinCurrentThread(ThreadBudget::TRACKING);
+}
+
 void System::StartViewer() {
   if (mpViewer)
     mpViewer->Run();
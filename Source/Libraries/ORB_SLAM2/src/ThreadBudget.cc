@@ -0,0 +1,104 @@
+#include "ThreadBudget.h"
+
+#include <algorithm>
+#include <iostream>
+#include <thread>
+
+#include <torch/torch.h>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+using namespace ::std;
+
+namespace ORB_SLAM2 {
+namespace ThreadBudget {
+
+static int g_nExtraction = 0;
+static bool g_bAffinity = false;
+static int g_vFirstCore[3] = {0, 0, 0};
+static int g_vNumCores[3] = {0, 0, 0};
+
+static int ReadInt(const cv::FileNode &node, const char *key, const int def) {
+  return node[key].empty() ? def : (int)node[key];
+}
+
+void init(const cv::FileNode &node) {
+  if (node.empty())
+    return;
+
+  g_nExtraction = max(0, ReadInt(node, "extraction", 0));
+
+  // LibTorch: intra-op pool used inside each SuperPoint forward pass. The inter-op
+  // pool can only be sized before its first use, LibTorch throws otherwise.
+  const int nTorch = ReadInt(node, "torch", 0);
+  if (nTorch > 0)
+    torch::set_num_threads(nTorch);
+  const int nTorchInterop = ReadInt(node, "torch_interop", 0);
+  if (nTorchInterop > 0) {
+    try {
+      torch::set_num_interop_threads(nTorchInterop);
+    } catch (const exception &e) {
+      cerr << "[ThreadBudget] torch_interop ignored: " << e.what() << endl;
+    }
+  }
+
+  // OpenCV: parallel_for_ pool (SIFT / KAZE / AKAZE internals, cv::dnn). 0 runs sequentially.
+  const int nOpenCV = ReadInt(node, "opencv", -1);
+  if (nOpenCV >= 0)
+    cv::setNumThreads(nOpenCV);
+
+  const int nExtractionCores = g_nExtraction > 0 ? g_nExtraction : 1;
+  g_vNumCores[TRACKING] = max(1, ReadInt(node, "tracking_cores", nExtractionCores));
+  g_vNumCores[MAPPING] = max(1, ReadInt(node, "mapping_cores", 1));
+  g_vNumCores[LOOP_CLOSING] = max(1, ReadInt(node, "loop_closing_cores", 1));
+
+  g_vFirstCore[TRACKING] = max(0, ReadInt(node, "first_core", 0));
+  g_vFirstCore[MAPPING] = g_vFirstCore[TRACKING] + g_vNumCores[TRACKING];
+  g_vFirstCore[LOOP_CLOSING] = g_vFirstCore[MAPPING] + g_vNumCores[MAPPING];
+
+  g_bAffinity = ReadInt(node, "affinity", 0) != 0;
+#ifndef __linux__
+  if (g_bAffinity) {
+    cerr << "[ThreadBudget] affinity is only supported on Linux, ignored" << endl;
+    g_bAffinity = false;
+  }
+#endif
+
+  cout << endl << "Thread Budget: " << endl;
+  cout << "- Extraction Threads: " << (g_nExtraction > 0 ? to_string(g_nExtraction) : string("auto")) << endl;
+  cout << "- LibTorch Threads: " << (nTorch > 0 ? to_string(nTorch) : string("default")) << endl;
+  cout << "- OpenCV Threads: " << (nOpenCV >= 0 ? to_string(nOpenCV) : string("default")) << endl;
+  cout << "- Affinity: " << g_bAffinity << endl;
+  if (g_bAffinity) {
+    const char *names[3] = {"Tracking", "Mapping", "Loop Closing"};
+    for (int r = 0; r < 3; r++)
+      cout << "  - " << names[r] << " Cores: [" << g_vFirstCore[r] << ", "
+           << g_vFirstCore[r] + g_vNumCores[r] << ")" << endl;
+  }
+}
+
+int extractionThreads() { return g_nExtraction; }
+
+void pinCurrentThread(Role role) {
+  if (!g_bAffinity)
+    return;
+
+#ifdef __linux__
+  // Core sets past the end of the machine wrap around
+  const int nHardware = max(1, static_cast<int>(thread::hardware_concurrency()));
+
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (int i = 0; i < g_vNumCores[role]; i++)
+    CPU_SET((g_vFirstCore[role] + i) % nHardware, &set);
+
+  if (pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &set) != 0)
+    cerr << "[ThreadBudget] failed to set thread affinity" << endl;
+#endif
+}
+
+} // namespace ThreadBudget
+} // namespace ORB_SLAM2
@@ -38,10 +38,13 @@
 #include "CorrelationEdge.h"
 #include "MapPoint.h"
 #include "Perf.h"
+#include "ThreadBudget.h"
 
+#include <algorithm>
 #include <chrono>
 #include <iostream>
 #include <mutex>
+#include <numeric>
 #include <thread>
 
 using namespace ::std;
@@ -165,6 +168,9 @@ Tracking::Tracking(System *pSys, std::vector<FbowVocabulary *> pVoc, std::vector
   for (auto it = extractor_list.begin(); it != extractor_list.end(); ++it)
       extractor_names.push_back((std::string)*it);
 
+  mpPyramidCacheLeft = new ImagePyramidCache();
+  mpPyramidCacheRight = new ImagePyramidCache();
+
   // Associator: Resize/Initialize TH vectors
   Associater::mvTH_LOW.resize(Ntype);
   Associater::mvTH_HIGH.resize(Ntype);
@@ -178,12 +184,17 @@ Tracking::Tracking(System *pSys, std::vector<FbowVocabulary *> pVoc, std::vector
     Associater::mvTH_HIGH[i] = static_cast<float>(extractor_config["TH_HIGH"]);
 
     mpFeatureExtractorLeft[i] = FeatureExtractorFactory::Instance().Create(name, extractor_config, false);
+    mpFeatureExtractorLeft[i]->SetPyramidCache(mpPyramidCacheLeft);
 
-    if (sensor == System::STEREO)
+    if (sensor == System::STEREO) {
       mpFeatureExtractorRight[i] = FeatureExtractorFactory::Instance().Create(name, extractor_config, false);
+      mpFeatureExtractorRight[i]->SetPyramidCache(mpPyramidCacheRight);
+    }
 
-    if (sensor == System::MONOCULAR)
+    if (sensor == System::MONOCULAR) {
       mpIniFeatureExtractor[i] = FeatureExtractorFactory::Instance().Create(name, extractor_config, true);
+      mpIniFeatureExtractor[i]->SetPyramidCache(mpPyramidCacheLeft);
+    }
 
     cout << endl << "[Feature " + std::to_string(i) + "] " + name + " Extractor Parameters: " << endl;
 	cout << " ( TH_LOW: " << static_cast<float>(extractor_config["TH_LOW"]) <<
@@ -191,6 +202,65 @@ Tracking::Tracking(System *pSys, std::vector<FbowVocabulary *> pVoc, std::vector
     mpFeatureExtractorLeft[i]->InfoConfigs();
   }
 
+  mpExtractorPool = new ExtractorPool(Ntype, ThreadBudget::extractionThreads());
+  cout << endl << "Extraction threads: " << mpExtractorPool->GetNumThreads() << endl;
+
+  std::vector<int> vnFeatures(Ntype);
+  std::vector<cv::FileNode> vExtractorConfigs(Ntype);
+  for (int i = 0; i < Ntype; ++i) {
+    vnFeatures[i] = mpFeatureExtractorLeft[i]->GetNumFeatures();
+    vExtractorConfigs[i] = fSettings[extractor_names[i]];
+  }
+  mpFeatureBudget = new FeatureBudget(fSettings["FeatureBudget"], vnFeatures, vExtractorConfigs);
+  mpFeatureBudget->InfoConfigs();
+  mvnMatchesInliers.assign(Ntype, 0);
+
+  // Lazy extraction of the secondary channels
+  cv::FileNode lazy_config = fSettings["LazyExtraction"];
+  mbLazyExtraction = lazy_config.empty() || lazy_config["enabled"].empty() ? false : ((int)lazy_config["enabled"] != 0);
+  mnLazyMinInliers = lazy_config.empty() || lazy_config["min_primary_inliers"].empty() ? 50 : (int)lazy_config["min_primary_inliers"];
+  mvbSecondaryChannel.assign(Ntype, false);
+  mbExtractAllNext = true;
+  if (mbLazyExtraction) {
+    cv::FileNode secondary_list = lazy_config["secondary"];
+    for (auto it = secondary_list.begin(); it != secondary_list.end(); ++it) {
+      const auto found = std::find(extractor_names.begin(), extractor_names.end(), (std::string)*it);
+      if (found != extractor_names.end())
+        mvbSecondaryChannel[found - extractor_names.begin()] = true;
+    }
+    // Some channel has to track every frame
+    const int nSecondary = std::count(mvbSecondaryChannel.begin(), mvbSecondaryChannel.end(), true);
+    if (nSecondary == 0 || nSecondary == Ntype)
+      mbLazyExtraction = false;
+  }
+
+  cout << endl << "Lazy Extraction: " << mbLazyExtraction << endl;
+  if (mbLazyExtraction) {
+    for (int i = 0; i < Ntype; ++i)
+      if (mvbSecondaryChannel[i])
+        cout << "- Secondary: " << extractor_names[i] << endl;
+    cout << "- Min Primary Inliers: " << mnLazyMinInliers << endl;
+  }
+
+  // Correlation-guided search of the cross-channel partners
+  cv::FileNode correlation_config = fSettings["CorrelationSearch"];
+  mbCorrelationSearch = correlation_config.empty() || correlation_config["enabled"].empty() ? false : ((int)correlation_config["enabled"] != 0);
+  mnCorrelationStrength = correlation_config.empty() || correlation_config["strength"].empty() ? 5 : (int)correlation_config["strength"];
+  mfCorrelationRadius = correlation_config.empty() || correlation_config["radius"].empty() ? 2.0f : (float)correlation_config["radius"];
+  mnCorrelationStrength = max(mnCorrelationStrength, 1);
+
+  cout << endl << "Correlation Search: " << mbCorrelationSearch << endl;
+  if (mbCorrelationSearch) {
+    cout << "- Min Edge Strength: " << mnCorrelationStrength << endl;
+    cout << "- Radius: " << mfCorrelationRadius << endl;
+  }
+
+  // Relocalization fallback through the keyframe descriptor indices
+  cv::FileNode reloc_index_config = fSettings["RelocalizationIndex"];
+  mbRelocalizationIndex = reloc_index_config.empty() || reloc_index_config["enabled"].empty() ? false : ((int)reloc_index_config["enabled"] != 0);
+
+  cout << endl << "Relocalization Index: " << mbRelocalizationIndex << endl;
+
   if (sensor == System::STEREO || sensor == System::RGBD) {
     mThDepth = mbf * (float)fSettings["ThDepth"] / fx;
     cout << endl << "Depth Threshold (Close/Far Points): " << mThDepth << endl;
@@ -247,8 +317,11 @@ cv::Mat Tracking::GrabImageStereo(const cv::Mat &imRectLeft, const cv::Mat &imRe
   //  cv::resize(imGrayRight, imGrayRight, cv::Size(320, 240), 0, 0, cv::INTER_NEAREST);
   //}
 
+  mpPyramidCacheLeft->SetImage(mImGray);
+  mpPyramidCacheRight->SetImage(imGrayRight);
+
   mCurrentFrame = Frame(mImGray, imGrayRight, timestamp, mpFeatureExtractorLeft, mpFeatureExtractorRight,
-                        mpVocabulary, mK, mDistCoef, mbf, mThDepth, Ntype);
+                        mpExtractorPool, mpVocabulary, mK, mDistCoef, mbf, mThDepth, Ntype, DeferredChannels());
 
   Track();
 
@@ -281,7 +354,10 @@ cv::Mat Tracking::GrabImageRGBD(const cv::Mat &imRGB, const cv::Mat &imD, const
   if ((fabs(mDepthMapFactor - 1.0f) > 1e-5) || imDepth.type() != CV_32F)
     imDepth.convertTo(imDepth, CV_32F, mDepthMapFactor);
 
-  mCurrentFrame = Frame(mImGray, imDepth, timestamp, mpFeatureExtractorLeft, mpVocabulary, mK, mDistCoef, mbf, mThDepth, Ntype);
+  mpPyramidCacheLeft->SetImage(mImGray);
+
+  mCurrentFrame = Frame(mImGray, imDepth, timestamp, mpFeatureExtractorLeft, mpExtractorPool, mpVocabulary, mK, mDistCoef, mbf, mThDepth, Ntype,
+                        DeferredChannels());
 
   Track();
 
@@ -309,10 +385,13 @@ cv::Mat Tracking::GrabImageMonocular(const cv::Mat &im, const double &timestamp)
   //  cv::resize(mImGray, mImGray, cv::Size(320, 240));
   //}
 
+  mpPyramidCacheLeft->SetImage(mImGray);
+
   if (mState == NOT_INITIALIZED || mState == NO_IMAGES_YET)
-    mCurrentFrame = Frame(mImGray, timestamp, mpIniFeatureExtractor, mpVocabulary, mK, mDistCoef, mbf, mThDepth, Ntype);
+    mCurrentFrame = Frame(mImGray, timestamp, mpIniFeatureExtractor, mpExtractorPool, mpVocabulary, mK, mDistCoef, mbf, mThDepth, Ntype);
   else
-    mCurrentFrame = Frame(mImGray, timestamp, mpFeatureExtractorLeft, mpVocabulary, mK, mDistCoef, mbf, mThDepth, Ntype);
+    mCurrentFrame = Frame(mImGray, timestamp, mpFeatureExtractorLeft, mpExtractorPool, mpVocabulary, mK, mDistCoef, mbf, mThDepth, Ntype,
+                          DeferredChannels());
 
   Track();
 
@@ -389,6 +468,7 @@ void Tracking::Track() {
 
     // System is initialized. Track Frame.
     bool bOK;
+    std::fill(mvnMatchesInliers.begin(), mvnMatchesInliers.end(), 0);
 
     // Initial camera pose estimation using motion model or relocalization (if tracking is lost)
     if (!mbOnlyTracking) {
@@ -515,12 +595,29 @@ void Tracking::Track() {
     else
       mState = LOST;
 
+    if (mpFeatureBudget->IsEnabled())
+      UpdateFeatureBudget(bOK);
+
+    // Weak tracking on the primary channels: extract every channel of the next frame
+    if (mbLazyExtraction) {
+      int nPrimaryInliers = 0;
+      for (int Ftype = 0; Ftype < Ntype; Ftype++)
+        if (!mvbSecondaryChannel[Ftype])
+          nPrimaryInliers += mvnMatchesInliers[Ftype];
+      mbExtractAllNext = !bOK || nPrimaryInliers < mnLazyMinInliers;
+    }
+
     // Update drawer
     for (int Ftype = 0; Ftype < Ntype; Ftype++)
       mpFrameDrawer[Ftype]->Update(this);
 
     // If tracking were good, check if we insert a keyframe
     if (bOK) {
+      // Keyframes always carry every channel: extract the deferred ones (this refines the pose)
+      const bool bNeedKF = NeedNewKeyFrameMultiChannels();
+      if (bNeedKF)
+        CompleteDeferredChannels();
+
       // Update motion model
       if (!mLastFrame.mTcw.empty()) {
         cv::Mat LastTwc = cv::Mat::eye(4, 4, CV_32F);
@@ -550,12 +647,7 @@ void Tracking::Track() {
       // Correlation Matching
       const float th_px = 2.0f;  // Threshold
 
-      for (int a = 0; a < Ntype; ++a) {
-        for (int b = a + 1; b < Ntype; ++b) {
-            float cRI = sMatcher.BuildEdges(mCurrentFrame, a, b, th_px, 5);
-            // std::cout << cRI << std::endl;
-        }
-      }
+      sMatcher.BuildEdges(mCurrentFrame, th_px, 5);
       }
 
       /*
@@ -592,7 +684,7 @@ void Tracking::Track() {
       mlpTemporalPoints.clear();
 
       // Check if we need to insert a new keyframe
-      if (NeedNewKeyFrameMultiChannels()) {
+      if (bNeedKF) {
         CreateNewKeyFrameMultiChannels();
       } // TO-DO Multi Channels ??
         
@@ -1475,6 +1567,9 @@ bool Tracking::Relocalization(const int Ftype) {
       vbDiscarded[i] = true;
     else {
       int nmatches = associater.SearchByBoW(pKF, mCurrentFrame, vvpMapPointMatches[i], Ftype);
+      // Few shared vocabulary words: match through the keyframe's descriptor index
+      if (mbRelocalizationIndex && nmatches < 15)
+        nmatches = associater.SearchByIndex(pKF, mCurrentFrame, vvpMapPointMatches[i], Ftype);
       if (nmatches < 15) {
         vbDiscarded[i] = true;
         continue;
@@ -1696,6 +1791,8 @@ void Tracking::UpdateLocalPointsMultiChannels() {
       }
     }
   }
+
+  mLocalMapDescriptors.Update(mvpLocalMapPoints, Ntype);
 }
 
 void Tracking::SearchLocalPointsMultiChannels() {
@@ -1714,36 +1811,71 @@ void Tracking::SearchLocalPointsMultiChannels() {
       }
     }
   }
+
+  // Partners of the matched points in the other channels, searched around the matched keypoints.
+  // They are marked as seen in this frame, so the wide search below skips them.
+  if (mbCorrelationSearch) {
+    ORB_SLAM2::Perf::Scoped __perf__("Correlation Search");
+    sMatcher.SearchCorrelated(mCurrentFrame, mfCorrelationRadius, mnCorrelationStrength);
+  }
   
-  int nToMatch = 0;
-  // Project points in frame and check its visibility
+  // Snapshot the local map by channel: until the joint pose optimization the channels share
+  // no map point and no keypoint, so each one is checked and searched independently
+  std::vector<MapPoint *> vpCandidates;
+  vpCandidates.reserve(mvpLocalMapPoints.size());
   for (vector<MapPoint *>::iterator vit = mvpLocalMapPoints.begin(), vend = mvpLocalMapPoints.end(); vit != vend; vit++) {
     MapPoint *pMP = *vit;
     if (pMP->mnLastFrameSeen == mCurrentFrame.mnId)
       continue;
     if (pMP->isBad())
       continue;
-    // Project (this fills MapPoint variables for matching)
-    if (mCurrentFrame.isInFrustum(pMP, 0.5)) {
-      pMP->IncreaseVisible();
-      nToMatch++;
+    const int Ftype = pMP->GetFeatureType();
+    // Channel not extracted on this frame: the point is neither visible nor matchable yet
+    if (mCurrentFrame.IsDeferred(Ftype)) {
+      pMP->mbTrackInView = false;
+      continue;
     }
+    // Points without a channel are counted as visible but never matched
+    if (Ftype < 0) {
+      if (mCurrentFrame.isInFrustum(pMP, 0.5))
+        pMP->IncreaseVisible();
+      continue;
+    }
+    vpCandidates.push_back(pMP);
   }
+  mLocalMapSnapshot.Assign(vpCandidates, Ntype);
 
-  if (nToMatch > 0) {
-    Associater associater(0.8);
-    int th = 1;
-    if(mSensor==System::RGBD)
-        th=3;
-    // If the camera has been relocalised recently, perform a coarser search
-    if(mCurrentFrame.mnId<mnLastRelocFrameId+2)
-        th=5;
-      
-    associater.SearchByProjection(mCurrentFrame, mvpLocalMapPoints, th);
+  int th = 1;
+  if(mSensor==System::RGBD)
+      th=3;
+  // If the camera has been relocalised recently, perform a coarser search
+  if(mCurrentFrame.mnId<mnLastRelocFrameId+2)
+      th=5;
+
+  // One task per channel on the extraction pool, each writing only its own channel of the frame
+  std::vector<std::vector<MapPoint *>> vvpVisible(Ntype);
+  for (int Ftype = 0; Ftype < Ntype; Ftype++) {
+    if (mLocalMapSnapshot.Size(Ftype) == 0)
+      continue;
+
+    mpExtractorPool->Submit(Ftype, [this, Ftype, th, &vvpVisible]() {
+      std::vector<MapPoint *> &vpVisible = vvpVisible[Ftype];
+
+      // Project (this fills MapPoint variables for matching)
+      mLocalMapSnapshot.Cull(mCurrentFrame, Ftype, 0.5, vpVisible);
+      for (MapPoint *pMP : vpVisible)
+        pMP->IncreaseVisible();
+
+      if (!vpVisible.empty()) {
+        Associater associater(0.8);
+        associater.SearchByProjection(mCurrentFrame, vpVisible, th, &mLocalMapDescriptors);
 
-    // // NN only matching
-    // associater.SearchByNN(mCurrentFrame, mvpLocalMapPoints);
+        // // NN only matching
+        // associater.SearchByNN(mCurrentFrame, vpVisible);
+      }
+    }, false);
   }
+  mpExtractorPool->Wait();
 }
 
 void Tracking::UpdateLocalMapMultiChannels() {
@@ -1768,19 +1900,22 @@ bool Tracking::TrackLocalMapMultiChannels() {
   mnMatchesInliers = 0;
 
   for (int Ftype = 0; Ftype < Ntype; Ftype++) {
+    int nInliers = 0;
     for (int i = 0; i < mCurrentFrame.Channels[Ftype].N; i++) {
       if (mCurrentFrame.Channels[Ftype].mvpMapPoints[i]) {
         if (!mCurrentFrame.Channels[Ftype].mvbOutlier[i]) {
           mCurrentFrame.Channels[Ftype].mvpMapPoints[i]->IncreaseFound();
           if (!mbOnlyTracking) {
             if (mCurrentFrame.Channels[Ftype].mvpMapPoints[i]->Observations() > 0)
-              mnMatchesInliers++;
+              nInliers++;
           } else
-            mnMatchesInliers++;
+            nInliers++;
         } else if (mSensor == System::STEREO)
           mCurrentFrame.Channels[Ftype].mvpMapPoints[i] = static_cast<MapPoint *>(NULL);
       }
     }
+    mvnMatchesInliers[Ftype] = nInliers;
+    mnMatchesInliers += nInliers;
   }
   
   // Decide if the tracking was succesful. More restrictive if there was a relocalization recently
@@ -1793,6 +1928,91 @@ bool Tracking::TrackLocalMapMultiChannels() {
     return true;
 }
 
+void Tracking::UpdateFeatureBudget(const bool bOK) {
+  // Frames tracked without the local map (lost, visual odometry) say nothing about the yield
+  if (!bOK || std::accumulate(mvnMatchesInliers.begin(), mvnMatchesInliers.end(), 0) == 0)
+    return;
+
+  // Deferred channels are extracted after the pose optimization, if at all: neither their keys,
+  // inliers nor extraction time belong to this frame
+  std::vector<int> vnKeys(Ntype);
+  std::vector<bool> vbSampled(Ntype);
+  for (int Ftype = 0; Ftype < Ntype; Ftype++) {
+    vnKeys[Ftype] = mCurrentFrame.Channels[Ftype].N;
+    vbSampled[Ftype] = !mCurrentFrame.IsDeferred(Ftype);
+  }
+
+  if (!mpFeatureBudget->AddFrame(vnKeys, mvnMatchesInliers, mpExtractorPool->GetLastRunTimes(), vbSampled))
+    return;
+
+  // The extraction pool is idle between frames, the extractors can be resized here
+  const std::vector<int> &vnBudget = mpFeatureBudget->GetBudgets();
+  for (int Ftype = 0; Ftype < Ntype; Ftype++) {
+    mpFeatureExtractorLeft[Ftype]->SetNumFeatures(vnBudget[Ftype]);
+    if (mSensor == System::STEREO)
+      mpFeatureExtractorRight[Ftype]->SetNumFeatures(vnBudget[Ftype]);
+  }
+}
+
+std::vector<bool> Tracking::DeferredChannels() const {
+  // Initialization, relocalization and weak tracking run on every channel
+  if (!mbLazyExtraction || mState != OK || mbExtractAllNext)
+    return std::vector<bool>();
+  return mvbSecondaryChannel;
+}
+
+void Tracking::CompleteDeferredChannels() {
+  const std::vector<int> vFtypes = mCurrentFrame.ExtractDeferredChannels(mpExtractorPool);
+  if (vFtypes.empty())
+    return;
+
+  // Project the local map points of the new channels at the tracked pose
+  std::vector<bool> vbNew(Ntype, false);
+  for (const int Ftype : vFtypes)
+    vbNew[Ftype] = true;
+
+  std::vector<MapPoint *> vpNewPoints;
+  for (vector<MapPoint *>::iterator vit = mvpLocalMapPoints.begin(), vend = mvpLocalMapPoints.end(); vit != vend; vit++) {
+    MapPoint *pMP = *vit;
+    const int Ftype = pMP->GetFeatureType();
+    if (pMP->isBad() || Ftype < 0 || !vbNew[Ftype])
+      continue;
+    vpNewPoints.push_back(pMP);
+  }
+  mLocalMapSnapshot.Assign(vpNewPoints, Ntype);
+
+  std::vector<MapPoint *> vpCandidates;
+  for (const int Ftype : vFtypes)
+    mLocalMapSnapshot.Cull(mCurrentFrame, Ftype, 0.5, vpCandidates);
+  for (MapPoint *pMP : vpCandidates)
+    pMP->IncreaseVisible();
+  if (vpCandidates.empty())
+    return;
+
+  Associater associater(0.8);
+  const int th = mSensor == System::RGBD ? 3 : 1;
+  associater.SearchByProjection(mCurrentFrame, vpCandidates, th, &mLocalMapDescriptors);
+
+  // Refine the pose with every channel, as TrackLocalMapMultiChannels
+  Optimizer::PoseOptimizationMultiChannels(&mCurrentFrame);
+
+  for (const int Ftype : vFtypes) {
+    int nInliers = 0;
+    for (int i = 0; i < mCurrentFrame.Channels[Ftype].N; i++) {
+      if (mCurrentFrame.Channels[Ftype].mvpMapPoints[i]) {
+        if (!mCurrentFrame.Channels[Ftype].mvbOutlier[i]) {
+          mCurrentFrame.Channels[Ftype].mvpMapPoints[i]->IncreaseFound();
+          if (mCurrentFrame.Channels[Ftype].mvpMapPoints[i]->Observations() > 0)
+            nInliers++;
+        } else if (mSensor == System::STEREO)
+          mCurrentFrame.Channels[Ftype].mvpMapPoints[i] = static_cast<MapPoint *>(NULL);
+      }
+    }
+    mvnMatchesInliers[Ftype] = nInliers;
+    mnMatchesInliers += nInliers;
+  }
+}
+
 bool Tracking::NeedNewKeyFrameMultiChannels() {
   
   // step 1 : check VO
@@ -1814,9 +2034,11 @@ bool Tracking::NeedNewKeyFrameMultiChannels() {
     nMinObs = 2;
 
   // sum all tracked map points
+  // (only over the channels extracted on the current frame, to compare like with like)
   int nRefMatches = 0;
   for (int Ftype = 0; Ftype < Ntype; Ftype++)
-    nRefMatches += mpReferenceKF->TrackedMapPoints(nMinObs, Ftype);
+    if (!mCurrentFrame.IsDeferred(Ftype))
+      nRefMatches += mpReferenceKF->TrackedMapPoints(nMinObs, Ftype);
 
   // step 5 : Local Mapping accept keyframes?
   bool bLocalMappingIdle = mpLocalMapper->AcceptKeyFrames();
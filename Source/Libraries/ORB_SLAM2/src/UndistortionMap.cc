@@ -0,0 +1,78 @@
+#include "UndistortionMap.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+using namespace ::std;
+
+namespace ORB_SLAM2 {
+
+const int UndistortionMap::STEP = 4;
+
+void UndistortionMap::Create(const cv::Mat &K, const cv::Mat &distCoef, const int cols, const int rows) {
+  mnNodesX = max(2, (int)ceil(static_cast<float>(cols) / STEP) + 1);
+  mnNodesY = max(2, (int)ceil(static_cast<float>(rows) / STEP) + 1);
+  const float stepX = static_cast<float>(cols) / (mnNodesX - 1);
+  const float stepY = static_cast<float>(rows) / (mnNodesY - 1);
+  mfInvStepX = 1.0f / stepX;
+  mfInvStepY = 1.0f / stepY;
+
+  // Undistort all nodes in one call
+  const int nNodes = mnNodesX * mnNodesY;
+  cv::Mat mat(nNodes, 1, CV_32FC2);
+  for (int j = 0; j < mnNodesY; j++) {
+    for (int i = 0; i < mnNodesX; i++) {
+      cv::Vec2f &p = mat.at<cv::Vec2f>(j * mnNodesX + i);
+      p[0] = i * stepX;
+      p[1] = j * stepY;
+    }
+  }
+  cv::undistortPoints(mat, mat, K, distCoef, cv::Mat(), K);
+
+  mvX.resize(nNodes);
+  mvY.resize(nNodes);
+  for (int k = 0; k < nNodes; k++) {
+    const cv::Vec2f &p = mat.at<cv::Vec2f>(k);
+    mvX[k] = p[0];
+    mvY[k] = p[1];
+  }
+}
+
+void UndistortionMap::Undistort(float *pX, float *pY, const int n) const {
+  const float *pTabX = mvX.data();
+  const float *pTabY = mvY.data();
+  const int nMaxX = mnNodesX - 2;
+  const int nMaxY = mnNodesY - 2;
+
+  for (int k = 0; k < n; k++) {
+    const float u = pX[k] * mfInvStepX;
+    const float v = pY[k] * mfInvStepY;
+    const int i = min(max((int)floor(u), 0), nMaxX);
+    const int j = min(max((int)floor(v), 0), nMaxY);
+    const float a = u - i;
+    const float b = v - j;
+
+    const int k00 = j * mnNodesX + i;
+    const int k10 = k00 + 1;
+    const int k01 = k00 + mnNodesX;
+    const int k11 = k01 + 1;
+
+    const float w00 = (1.0f - a) * (1.0f - b);
+    const float w10 = a * (1.0f - b);
+    const float w01 = (1.0f - a) * b;
+    const float w11 = a * b;
+
+    pX[k] = w00 * pTabX[k00] + w10 * pTabX[k10] + w01 * pTabX[k01] + w11 * pTabX[k11];
+    pY[k] = w00 * pTabY[k00] + w10 * pTabY[k10] + w01 * pTabY[k01] + w11 * pTabY[k11];
+  }
+}
+
+cv::Point2f UndistortionMap::Undistort(const float x, const float y) const {
+  float u = x, v = y;
+  Undistort(&u, &v, 1);
+  return cv::Point2f(u, v);
+}
+
+} // namespace ORB_SLAM2